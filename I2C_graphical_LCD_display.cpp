@@ -42,6 +42,63 @@
 																 -- To use MCP23S17 interface, #define MCP23S17
 
  version 4.1 : 08 June 2020			 -- Added bit operation optimization for ESP8266																 
+ Version 4.2 : 18 October 2026   -- added ASYNC_FLUSH option: draw into the cache, then send only changed bytes
+                                 -- with flush(), or in the background with flushAsync()/flushTick()/isBusy()
+ Version 4.3 : 18 October 2026   -- SPI busy delay is now counted from the end of the previous LCD operation,
+                                 -- and only applied before operations that pulse enable, not every transaction
+                                 -- added setBusyDelay(), calibrateBusyDelay() and LCD_BUSY_POLL (busy flag polling)
+ Version 4.4 : 18 October 2026   -- added LCD_timing, passed to begin(), for I2C/SPI clocks, SPI mode, enable width and busy delay
+                                 -- added tuneBusClock() to find the fastest bus clock that reads back correctly
+                                 -- MCP23017 and MCP23S17 builds now include both Wire and SPI, which the code needs
+ Version 4.5 : 18 October 2026   -- added HC595_SPI and HC595_SPI_LATCH: 74HC595 interface driven by hardware SPI
+ Version 5.0 : 18 October 2026   -- bus code moved into transport classes (KS0108_transport.h/.cpp): KS0108_2wire,
+                                 -- KS0108_MCP23017, KS0108_MCP23S17 - pass one to the constructor to choose the bus at run time
+                                 -- background flush sends each run through the transport in one go
+ Version 5.1 : 18 October 2026   -- added LCD_WIDTH and LCD_HEIGHT for panels of up to 4 chips (192x64, 240x64, 128x128)
+                                 -- CS3/CS4 on GPA1/GPA0 of the MCP23x17 and IC2 QF/QG of the 74HC595 board
+ Version 5.2 : 18 October 2026   -- added LCD_ROTATION and setOrientation(): 0/90/180/270 degree rotation and X/Y mirroring,
+                                 -- with width() and height() for the size as drawn
+                                 -- clear(), fillRect() and frameRect() stop at the edge of the screen (their default end is now 0xFF)
+ Version 5.3 : 18 October 2026   -- added LCD_GRAYSCALE: 4 gray levels from two bitplanes shown 2:1 in turn by grayTick() (or Timer2),
+                                 -- with setGrayPixel(), getGrayPixel(), fillGrayRect() and setGrayscale()
+ Version 5.4 : 18 October 2026   -- added drawGrayImage() (8-bit pictures, ordered dither on the fly) and blitRLE() (run-length encoded pictures)
+                                 -- added extras/ks0108conv.cpp to turn PGM pictures into headers for blit, blitRLE and drawGrayImage
+ Version 5.5 : 18 October 2026   -- Added setDrawMode (copy, set, clear, xor) and invertRect
+                                 -- circle, fillCircle and frameRect draw each pixel once
+                                 -- setPixel no longer garbled by setInv
+ Version 5.6 : 18 October 2026   -- Added retained-mode widgets (KS0108_widgets.h) and glyphColumn
+ Version 5.7 : 18 October 2026   -- LCD_bar can fill upwards, and only sends the part that changed
+ Version 5.8 : 18 October 2026   -- LCD_value redraws only changed letters, has fixed point and alignment
+ Version 5.9 : 18 October 2026   -- added LCD_GLYPH_CACHE: recently drawn letters kept in RAM, ready to send
+ Version 6.0 : 18 October 2026   -- added KS0108_fonts.h: LCD_font (size as template arguments) for letter() and string(),
+                                 -- and LCD_FONT_SUBSET to build a font of just the letters used, at compile time
+ Version 6.1 : 18 October 2026   -- added setUnicodeFont(): fonts of any code points, found by binary search, with UTF-8
+                                 -- text in string() and print(); LCD_UNICODE_FROM_CP437 builds one from cp437_font
+ Version 6.2 : 18 October 2026   -- added fillTriangle() and fillPolygon(): filled a column at a time, each byte of
+                                 -- the screen read and written once
+ Version 6.3 : 18 October 2026   -- added fill patterns (setPattern, setUserPattern) for fillRect, fillCircle and polygons;
+                                 -- fillRect and fillCircle now change each byte once, down each column
+ Version 6.4 : 18 October 2026   -- added copyRect(): copies (or moves, if they overlap) part of the screen to another place
+ Version 6.5 : 18 October 2026   -- added scrollRegion(): scrolls part of the screen sideways, bringing in new columns,
+                                 -- each line sent in one run
+ Version 6.6 : 18 October 2026   -- added saveRegion() and restoreRegion(), with an optional arena (LCD_REGION_ARENA), to put
+                                 -- back what was under popups and menus
+ Version 6.7 : 18 October 2026   -- begin() waits for the LCD's reset flag (MCP23x17) and blanks the LCD in runs, a line of each chip at a time
+ Version 6.8 : 18 October 2026   -- LCD_VERIFY: verifyTick() checks the screen a line at a time against the cache and repaints what differs
+                                 -- busErrors() counts I2C transfers the MCP23017 didn't acknowledge
+ Version 6.9 : 18 October 2026   -- KS0108_displaylist.h: record drawing calls (or keep them in PROGMEM) and draw them a line at a time,
+                                 -- sending each byte touched once
+ Version 7.0 : 18 October 2026   -- Added flushSome(), flushFor() and pending() (ASYNC_FLUSH): send changes a slice at a time from
+                                 -- loop(), shortest rows first
+ Version 7.1 : 18 October 2026   -- KS0108_display is the display without a built-in transport, for use with your own;
+                                 -- I2C_graphical_LCD_display builds in the 2-wire / MCP23x17 one (no longer takes a transport)
+ Version 7.2 : 18 October 2026   -- verifyTick() puts the LCD's address back for a run flushSome() is part way through
+ Version 7.3 : 18 October 2026   -- LCD_BUSY_POLL also polls between the bytes of a run (MCP23S17), instead of waiting out the busy delay
+ Version 7.4 : 18 October 2026   -- grayTick() puts the LCD's address back for the drawing code or a part-sent flush run, and sets its own
+                                 -- again when carrying on with a row
+ Version 7.5 : 18 October 2026   -- drawGrayImage() no longer inverts or XORs the pixels above and below a picture that ends part way down a line
+ Version 7.6 : 18 October 2026   -- LCD_bar and LCD_sparkline scale in long, so a range wider than 32767 no longer overflows on AVR
+ Version 7.7 : 18 October 2026   -- LCD_value's width is worked out from the number of digits it can actually show
  
  * These changes required hardware changes to pin configurations
  
@@ -73,11 +130,20 @@
 
 #include "I2C_graphical_LCD_display.h"
 
-// SPI is so fast we need to give the LCD time to catch up.
-// This is the number of microseconds we wait. Something like 20 to 50 is probably reasonable.
-//  Increase this value if the display is either not working, or losing data.
+// KS0108 status byte (read with D/I low)
+#define LCD_STATUS_BUSY   0x80
+#define LCD_STATUS_RESET  0x10
 
-#define LCD_BUSY_DELAY 50   // microseconds
+// chip select lines for each chip, in the order the chips appear on the panel
+static const byte lcdChipSelect [4] = { LCD_CS1, LCD_CS2, LCD_CS3, LCD_CS4 };
+
+#ifdef LCD_GRAYSCALE
+// grayscale phases (_grayPhase)
+#define GRAY_SHOW_HI  0   // first plane (the cache) is on the LCD, for 2 frames
+#define GRAY_SEND_LO  1   // sending the second plane where it differs
+#define GRAY_SHOW_LO  2   // second plane is on the LCD, for 1 frame
+#define GRAY_SEND_HI  3   // putting the first plane back
+#endif
 
 // font data - each character is 8 pixels deep and 5 pixels wide
 
@@ -186,116 +252,87 @@ const byte font [96] [5] PROGMEM = {
   
 };
 
-// Port manipulation macros for 2-wire interface
-#if defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
-#define clkpulse() {*_clkPort |= _clkMask; *_clkPort ^= _clkMask;}
-#define setdata(v) {if(v) *_dataPort |= _dataMask; else *_dataPort &= ~_dataMask;}
-#elif defined(digitalWriteFast)
-#define clkpulse() {digitalWriteFast(_clkPin, HIGH); digitalWriteFast(_clkPin, LOW);}
-#define setdata(v) {digitalWriteFast(_dataPin, v);}
-#elif defined(ARDUINO_ARCH_ESP8266)
-#define clkpulse() {GPOS = _clkMask; GPOC = _clkMask;}
-#define setdata(v) {if(v) GPOS = _dataMask; else GPOC = _dataMask;}
-#else
-#define clkpulse() {digitalWrite(_clkPin, HIGH); digitalWrite(_clkPin, LOW);}
-#define setdata(v) {digitalWrite(_dataPin, v);}
-#endif
-
-#define sendbit(v) {setdata(v); clkpulse();}
-
-#if !defined(MCP23x17)
-void I2C_graphical_LCD_display::do2wireSend(const byte rs, const byte data, const byte enable)
+// find the shortest busy delay that still works, by writing a test pattern to
+// the top line of each chip and reading it back at successively longer delays
+// the result (plus a safety margin) becomes the busy delay, and is returned
+// the display contents are destroyed, so call this before drawing anything
+// only useful for SPI - with I2C (and 2-wire) the busy delay is not used
+byte KS0108_display::calibrateBusyDelay ()
 {
-	sendbit(1);		// Leading 1 to eventually enable latch
-	sendbit(0);		// fillers
-	sendbit(0);
-	sendbit(enable);	// LCD enable
-	sendbit(rs);	// rs is 0 for command, 1 for data
-	byte t = data;
-	for(char i = 0; i < 8; ++i)	 // send data byte one bit at a time, LSB first
-	{
-		sendbit(t & 0x01);
-		t >>= 1;
-	}
-	sendbit((_chipSelect & LCD_CS1) != 0);
-	sendbit((_chipSelect & LCD_CS2) != 0);
-	sendbit(1);			// Latch new data
-	sendbit(0);
-//	for(int i = 0; i < 15; ++i)
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-	clkpulse();		// Clear the shifter
-}
-#endif
+  // (a busy delay of 0 here means the transport does not use one)
+  if (!_transport->canRead () || !_transport->getBusyDelay ())
+    return _transport->getBusyDelay ();
 
-#if defined(MCP23017)
-// glue routines for version 1.0+ of the IDE
-uint8_t i2c_read ()
-{
-#if defined(ARDUINO) && ARDUINO >= 100
-  return Wire.read ();
-#else
-  return Wire.receive ();
-#endif
-} // end of Nunchuk::i2c_read
+  byte d;
 
-void i2c_write (int data)
-{
-#if defined(ARDUINO) && ARDUINO >= 100
-  Wire.write (data);
-#else
-  Wire.send (data);
-#endif
-} // end of Nunchuk::i2c_write
-#endif  //defined(MCP23017)
+  for (d = 0; d < LCD_BUSY_DELAY; d += 2)
+    {
+    _transport->setBusyDelay (d);
+    if (testPattern ())
+      break;
+    }
 
-#if defined(MCP23x17)
-// prepare for sending to MCP23017 
-void I2C_graphical_LCD_display::startSend ()   
+  // leave some margin for temperature and supply variations
+  d = d + (d >> 2) + 2;
+  if (d > LCD_BUSY_DELAY)
+    d = LCD_BUSY_DELAY;
+  _transport->setBusyDelay (d);
+  return d;
+}  // end of KS0108_display::calibrateBusyDelay
+
+// write a test pattern to the top line of each chip and read it back
+// returns true if every byte came back correctly
+boolean KS0108_display::testPattern ()
 {
-  
-  if (_ssPin)
+  const byte oldChipSelect = _chipSelect;
+  boolean ok = true;
+
+  for (byte chip = 0; chip < LCD_CHIPS && ok; chip++)
     {
-    delayMicroseconds(LCD_BUSY_DELAY);
-    digitalWrite (_ssPin, LOW); 
-    SPI.transfer (_port << 1);
+    _chipSelect = lcdChipSelect [chip];
+    cmd (LCD_SET_PAGE | 0);
+    cmd (LCD_SET_ADD  | 0);
+    for (byte x = 0; x < 64; x++)
+      sendData ((x & 1) ? x ^ 0xA5 : x ^ 0x5A);
+
+    for (byte x = 0; x < 64 && ok; x++)
+      {
+      cmd (LCD_SET_ADD | x);
+      if (_transport->readData (_chipSelect) != ((x & 1) ? x ^ 0xA5 : x ^ 0x5A))
+        ok = false;
+      }
     }
-  else
-    Wire.beginTransmission (_port);
-  
-}  // end of I2C_graphical_LCD_display::startSend
 
-// send a byte via SPI or I2C
-void I2C_graphical_LCD_display::doSend (const byte what)   
-{
-  if (_ssPin)
-    SPI.transfer (what);
-  else
-    i2c_write (what);
-}  // end of I2C_graphical_LCD_display::doSend
+  _chipSelect = oldChipSelect;
+  return ok;
+}  // end of KS0108_display::testPattern
 
-// finish sending to MCP23017 
-void I2C_graphical_LCD_display::endSend ()   
+// find the fastest I2C or SPI clock at which a test pattern still reads back
+// correctly, stepping up from the slowest, and leave the bus running at it
+// returns the clock chosen (Hz)
+// the display contents are destroyed, so call this before drawing anything
+// (returns 0, and changes nothing, if the transport can't read back or has no clock to set)
+unsigned long KS0108_display::tuneBusClock ()
 {
-  if (_ssPin)
-    digitalWrite (_ssPin, HIGH); 
-  else
-    Wire.endTransmission ();
- 
-}  // end of I2C_graphical_LCD_display::endSend
-#endif
+  const unsigned long * clocks;
+  const byte count = _transport->busClocks (clocks);
+
+  if (!count || !_transport->canRead ())
+    return 0;
+
+  unsigned long best = clocks [0];
+
+  for (byte i = 0; i < count; i++)
+    {
+    _transport->setBusClock (clocks [i]);
+    if (!testPattern ())
+      break;
+    best = clocks [i];
+    }
+
+  _transport->setBusClock (best);
+  return best;
+}  // end of KS0108_display::tuneBusClock
 
 
 // set up - call before using
@@ -303,283 +340,313 @@ void I2C_graphical_LCD_display::endSend ()
 //  * the port that the MCP23017 is on (default 0x20)
 //  * the i2c port (default 0)
 //  * the SPI SS (slave select) pin - leave as default of zero for I2C operation
+// (the 2-wire board ignores all three: its pins were given to the constructor)
 
-// turns LCD on, clears memory, sets the cursor to 0,0
-
-// Approx time to run: 600 ms on Arduino Uno
+// turns LCD on, clears memory, sets the cursor to 0,0 (see KS0108_display::begin)
 void I2C_graphical_LCD_display::begin (const byte port, 
                                        const byte i2cAddress,
                                        const byte ssPin)
 {
-#if !defined(MCP23x17)
-//  if (_clkPin > 0 && _dataPin > 0)		//If 2-argument constructor was used, it's the 2-wire interface
-//  {
-		_port = 0;
-		_ssPin = 0;
-#if defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
-		_clkPort = portOutputRegister(digitalPinToPort(_clkPin));
-		_dataPort = portOutputRegister(digitalPinToPort(_dataPin));
-		_clkMask = digitalPinToBitMask(_clkPin);
-		_dataMask = digitalPinToBitMask(_dataPin);
-#endif
-#if defined(ARDUINO_ARCH_ESP8266)
-		_clkMask = 1<<_clkPin;
-		_dataMask = 1<<_dataPin;
-#endif
-		pinMode(_clkPin, OUTPUT);
-		pinMode(_dataPin, OUTPUT);
-		digitalWrite(_clkPin, LOW);
-		_chipSelect = 0;
-		do2wireSend(0, 0, 0);			// clear the shifter and latch
-//  }
-//  else																// it's the MCP23x17 port expander interface
+  begin (LCD_timing (), port, i2cAddress, ssPin);
+}  // end of I2C_graphical_LCD_display::begin (initializer)
+
+// as above, but also specify the bus clocks and LCD timing to use
+void I2C_graphical_LCD_display::begin (const LCD_timing & timing,
+                                       const byte port, 
+                                       const byte i2cAddress,
+                                       const byte ssPin)
+{
+#if defined(MCP23x17)
+  // use I2C or SPI according to whether we have an SS pin
+#if defined(MCP23S17) && defined(MCP23017)
+  if (ssPin)
+    {
+    _spi = KS0108_MCP23S17 (ssPin, port);
+    _transport = &_spi;
+    }
+  else
+    {
+    _i2c = KS0108_MCP23017 (port, i2cAddress);
+    _transport = &_i2c;
+    }
+#elif defined(MCP23S17)
+  _spi = KS0108_MCP23S17 (ssPin ? ssPin : 10, port);
+  _transport = &_spi;
 #else
-//  {
-		_port = port;   // remember port
-		_ssPin = ssPin; // and SPI slave select pin
-			
-		if (_ssPin)
-			SPI.begin ();
-		else
-			Wire.begin (i2cAddress);   
-
-		// un-comment next line for faster I2C communications:
-		//   TWBR = 12;
-
-		// byte mode (not sequential)
-		expanderWrite (IOCON, 0b00100000);
-			
-		// all pins as outputs
-		expanderWrite (IODIRA, 0);
-		expanderWrite (IODIRB, 0);
-			
-		// take reset line low
-		startSend ();
-			doSend (GPIOA);
-			doSend (0); // all lines low
-		endSend ();
-			
-		// now raise reset (and enable) line and wait briefly
-		expanderWrite (GPIOA, LCD_ENABLE | LCD_RESET);
-//  }
-#endif
-
-	delay(2);	// time for LCD to finish resetting
+  _i2c = KS0108_MCP23017 (port, i2cAddress);
+  _transport = &_i2c;
+#endif
+#endif
+
+  KS0108_display::begin (timing);
+}  // end of I2C_graphical_LCD_display::begin (with timing)
+
+// turns LCD on, clears memory, sets the cursor to 0,0, using the given bus clocks and LCD timing
+// waits only as long as the LCD takes to reset (if it can be read), and clears it a line of
+// each chip at a time, in runs (see wipe), so a sketch can have something on the screen quickly
+void KS0108_display::begin (const LCD_timing & timing)
+{
+  // set up the bus and reset the LCD
+  _transport->begin (timing);
+  _chipSelect = 0;
+
+  waitReset ();
+
+#ifdef ASYNC_FLUSH
+  // nothing queued yet
+  memset (_dirtyLo, 0xFF, sizeof _dirtyLo);
+  memset (_dirtyHi, 0, sizeof _dirtyHi);
+  _flushBusy = false;
+  _flushRow = 0;
+  _flushX = 1;
+  _flushEnd = 0;
+  _flushDone = NULL;
+#endif
+
+#ifdef LCD_VERIFY
+  // start checking from the top-left
+  _verifyRow = 0;
+  resetVerifyCounts ();
+#endif
 
   // Select default built-in font
 	setFont();
 
-  // turn LCD chip 1 on
-  _chipSelect = LCD_CS1;
-  cmd (LCD_ON);
+  // pixels are drawn as given, and fills are solid
+  _drawMode = LCD_MODE_COPY;
+  setPattern (LCD_PATTERN_SOLID);
+
+#ifdef LCD_REGION_ARENA
+  // no regions saved yet
+  _arenaUsed = 0;
+#endif
+
+#ifdef LCD_ROTATION
+  // draw the right way up, until told otherwise
+  _orient = 0;
+#endif
+
+#ifdef LCD_GRAYSCALE
+  // not cycling, and (after the clear below) both planes the same
+  memset (_grayFirst, 0xFF, sizeof _grayFirst);
+  memset (_grayLast, 0, sizeof _grayLast);
+  _grayOn = false;
+  _grayPhase = GRAY_SHOW_HI;
+  _grayBudget = 32;
+  _grayFrame = 5000;
+#endif
 
-  // turn LCD chip 2 on
-  _chipSelect = LCD_CS2;
-  cmd (LCD_ON);
+  // turn each LCD chip on
+  for (byte chip = 0; chip < LCD_CHIPS; chip++)
+    {
+    _chipSelect = lcdChipSelect [chip];
+    cmd (LCD_ON);
+    }
   
   // clear entire LCD display
-  clear ();
+  wipe ();
   
   // and put the cursor in the top-left corner
   gotoxy (0, 0);
   
   // ensure scroll is set to zero
   scroll (0);   
-  
-}  // end of I2C_graphical_LCD_display::begin (initializer)
+
+}  // end of KS0108_display::begin
+
+// wait for each chip to finish resetting - if the LCD can be read, just until its status
+// says so, otherwise long enough for any of them
+void KS0108_display::waitReset ()
+{
+  if (!_transport->canRead ())
+    {
+    delay (2);	// time for LCD to finish resetting
+    return;
+    }
+
+  const unsigned long start = micros ();
+  for (byte chip = 0; chip < LCD_CHIPS; chip++)
+    while ((_transport->readStatus (lcdChipSelect [chip]) & (LCD_STATUS_BUSY | LCD_STATUS_RESET))
+           && micros () - start < 2000)
+      { }   // (still resetting)
+}  // end of KS0108_display::waitReset
+
+// blank the whole LCD, sending each line of each chip as one run, and the cache to match -
+// rather than clear (), which goes through the cache (and drawing mode) a byte at a time
+void KS0108_display::wipe ()
+{
+#ifdef WRITETHROUGH_CACHE
+  memset (_cache, 0, sizeof _cache);
+#endif
+#ifdef LCD_GRAYSCALE
+  memset (_plane, 0, sizeof _plane);
+#endif
+
+  const byte blank = 0;
+  for (byte chip = 0; chip < LCD_CHIPS; chip++)
+    {
+    _chipSelect = lcdChipSelect [chip];
+    for (byte page = 0; page < 8; page++)
+      {
+      cmd (LCD_SET_PAGE | page);
+      cmd (LCD_SET_ADD | 0);
+      _transport->writeDataRun (_chipSelect, &blank, 64, 0);
+      }
+    }
+}  // end of KS0108_display::wipe
 
 
 // send command to LCD display (chip 1 or 2 as in chipSelect variable)
 // for example, setting page (Y) or address (X)
-void I2C_graphical_LCD_display::cmd (const byte data)
-{
-//	if (_clkPin > 0)
-//	{
-#if !defined(MCP23x17)
-		do2wireSend(0, data, 1);		// rs is 0 meaning instruction, raise enable
-		do2wireSend(0, data, 0);		// now drop enable
-//	}
-//	else
-//	{
-#else
-  startSend ();
-    doSend (GPIOA);                      // control port
-    doSend (LCD_RESET | LCD_ENABLE | _chipSelect);   // set enable high (D/I is low meaning instruction) 
-    doSend (data);                       // (command written to GPIOB)
-    doSend (LCD_RESET | _chipSelect);    // (GPIOA again) pull enable low to toggle data 
-  endSend ();
-//	}
-#endif
-} // end of I2C_graphical_LCD_display::cmd 
+void KS0108_display::cmd (const byte data)
+{
+  _transport->writeCommand (_chipSelect, data);
+} // end of KS0108_display::cmd 
 
 // set our "cursor" to the x/y position
-// works out whether this refers to chip 1 or chip 2 and sets chipSelect appropriately
+// works out which chip this refers to and sets chipSelect appropriately
 
 // Approx time to run: 33 ms on Arduino Uno
-void I2C_graphical_LCD_display::gotoxy (byte x, 
-                                        byte y)
+void KS0108_display::gotoxy (byte x, 
+                             byte y)
 {
+#ifdef LCD_ROTATION
+  // rotated or mirrored? just remember where we are - writeRotated() works out the rest
+  if (_orient)
+    {
+    _rotX = x < width () ? x : 0;
+    _rotY = y < height () ? y : 0;
+    return;
+    }
+#endif
 
-  if (x > 127) 
+  if (x >= LCD_WIDTH) 
     x = 0;                
-  if (y > 63)  
+  if (y >= LCD_HEIGHT)  
     y = 0;
   
-#ifdef WRITETHROUGH_CACHE
-  _cacheOffset = 0;
-#endif
-  
-  // work out which chip
-  if (x >= 64)
-    {
-    x -= 64;  
-    _chipSelect = LCD_CS2;
-#ifdef WRITETHROUGH_CACHE
-    _cacheOffset = 64 * 64 / 8;  // half-way through cache
-#endif
-      
-    }
-  else
-    _chipSelect = LCD_CS1;
+  // work out which chip - each one is 64 pixels square
+  _chip = (y >> 6) * LCD_CHIPS_ACROSS + (x >> 6);
+  _chipSelect = lcdChipSelect [_chip];
+  x &= 63;
   
   // remember for incrementing later
   _lcdx = x;
   _lcdy = y;
   
+#ifndef ASYNC_FLUSH
   // command LCD to the correct page and address
-  cmd (LCD_SET_PAGE | (y >> 3) );  // 8 pixels to a page
+  // (when flushing later, flushTick() does this for each run of changed bytes)
+  cmd (LCD_SET_PAGE | ((y >> 3) & 7) );  // 8 pixels to a page
   cmd (LCD_SET_ADD  | x );          
+#endif
   
 #ifdef WRITETHROUGH_CACHE
-  _cacheOffset += (x << 3) | y >> 3;
+  // 512 bytes for each chip
+  _cacheOffset = (_chip << 9) + ((x << 3) | ((y >> 3) & 7));
 #endif  
-}  // end of I2C_graphical_LCD_display::gotoxy 
-
-#if defined(MCP23x17)
-// set register "reg" on expander to "data"
-// for example, IO direction
-void I2C_graphical_LCD_display::expanderWrite (const byte reg, 
-                                               const byte data ) 
-{
-  startSend ();
-    doSend (reg);
-    doSend (data);
-  endSend ();
-} // end of I2C_graphical_LCD_display::expanderWrite
-#endif
+}  // end of KS0108_display::gotoxy 
 
 // read the byte corresponding to the selected x,y position
-byte I2C_graphical_LCD_display::I2C_graphical_LCD_display::readData ()
+byte KS0108_display::readData ()
 {
   
+#if defined(LCD_ROTATION)
+  if (_orient)
+    return readRotated ();
+#endif
 #if defined(WRITETHROUGH_CACHE)
   return _cache [_cacheOffset];
-
 #else
-  // data port (on the MCP23017) is now input
-  expanderWrite (IODIRB, 0xFF);
-  
-  // lol, see the KS0108 spec sheet - you need to read twice to get the data
-  startSend ();
-    doSend (GPIOA);                  // control port
-    doSend (LCD_RESET | LCD_READ | LCD_DATA | LCD_ENABLE | _chipSelect);  // set enable high 
-  endSend ();
-
-  startSend ();
-    doSend (GPIOA);                  // control port
-    doSend (LCD_RESET | LCD_READ | LCD_DATA | _chipSelect);  // pull enable low to toggle data 
-  endSend ();
-
-  startSend ();
-  doSend (GPIOA);                  // control port
-  doSend (LCD_RESET | LCD_READ | LCD_DATA | LCD_ENABLE | _chipSelect);  // set enable high 
-  endSend ();
-
-  byte data;
-
-  if (_ssPin)
-    {
-    digitalWrite (_ssPin, LOW); 
-    SPI.transfer ((_port << 1) | 1);  // read operation has low-bit set
-    SPI.transfer (GPIOB);             // which register to read from
-    data = SPI.transfer (0);          // get byte back
-    digitalWrite (_ssPin, HIGH); 
-    }
-  else
-    {
-    // initiate blocking read into internal buffer
-    Wire.requestFrom (_port, (byte) 1);
-    
-    // don't bother checking if available, Wire.receive does that anyway
-    //  also it returns 0x00 if nothing there, so we don't need to bother doing that
-    data = i2c_read ();
-    }  
-
-  // drop enable AFTER we have read it
-  startSend ();
-  doSend (GPIOA);                  // control port
-  doSend (LCD_RESET | LCD_READ | LCD_DATA | _chipSelect);  // pull enable low to toggle data 
-  endSend ();
-
-  // data port (on the MCP23017) is now output again
-  expanderWrite (IODIRB, 0);
-  
-  return data;
+  return _transport->readData (_chipSelect);
 #endif
-}  // end of I2C_graphical_LCD_display::readData
+}  // end of KS0108_display::readData
+
+// send a data byte to the currently-selected chip, at its current address
+// (the LCD advances its own address afterwards)
+void KS0108_display::sendData (const byte data)
+{
+  _transport->writeData (_chipSelect, data);
+}  // end of KS0108_display::sendData
 
 // write a byte to the LCD display at the selected x,y position
 // if inv true, invert the data
 // writing advances the cursor 1 pixel to the right
 // it wraps to the next "line" if necessary (a line is 8 pixels deep)
-void I2C_graphical_LCD_display::writeData (byte data, 
-                                           const boolean inv)
+void KS0108_display::writeData (byte data, 
+                                const boolean inv)
 {
   // invert data to be written if wanted
   if (inv)
     data ^= 0xFF;
-  
-//  if (_clkPin > 0)		// Are we using the 2-wire interface
-//	{
-#if !defined(MCP23x17)
-		do2wireSend(1, data, 1);		// rs is 1 to indicate data, raise enable
-		do2wireSend(1, data, 0);		// now drop enable
-//	}
-//	else
-//	{
-#else
-	// note that the MCP23x17 automatically toggles between port A and port B
-  // so the four sends do this:
-  //   1. Choose initial port as GPIOA (general IO port A)
-  //   2. Port A: set E high
-  //   3. Port B: send the data byte
-  //   4. Port A: set E low to toggle the transfer of data
-
-  startSend ();
-    doSend (GPIOA);                  // control port
-    doSend (LCD_RESET | LCD_DATA | LCD_ENABLE | _chipSelect);  // set enable high 
-    doSend (data);                   // (screen data written to GPIOB)
-    doSend (LCD_RESET | LCD_DATA | _chipSelect);  // (GPIOA again) pull enable low to toggle data 
-  endSend ();
-//	}
+
+  // combine with what is there already, unless just copying
+  if (_drawMode != LCD_MODE_COPY)
+    {
+    const byte old = readData ();
+#ifndef WRITETHROUGH_CACHE
+    // go back to that place (because readData() moved it)
+    gotoxy (((_chip % LCD_CHIPS_ACROSS) << 6) + _lcdx, _lcdy);
+#endif
+    switch (_drawMode)
+      {
+      case LCD_MODE_SET:   data |= old;  break;
+      case LCD_MODE_CLEAR: data = old & ~data; break;
+      case LCD_MODE_XOR:   data ^= old;  break;
+      }
+    }
+
+  putData (data);
+}  // end of KS0108_display::writeData
+
+// write a byte at the selected x,y position exactly as given, and move right
+void KS0108_display::putData (const byte data)
+{
+#ifdef LCD_ROTATION
+  if (_orient)
+    {
+    writeRotated (data);
+    return;
+    }
+#endif
+
+#ifndef ASYNC_FLUSH
+  sendData (data);
 #endif
 
 #ifdef WRITETHROUGH_CACHE
   _cache [_cacheOffset] = data;
 #endif 
+
+#ifdef LCD_GRAYSCALE
+  // normal drawing is black or white, so both planes get the same
+  _plane [_cacheOffset] = data;
+#endif
+
+#ifdef ASYNC_FLUSH
+  // remember this column needs sending (the cache is updated first, so a run
+  // flushTick() takes from now on sends the new byte)
+  markDirty ((_cacheOffset & 7) | (_chip << 3), _lcdx, _lcdx);
+#endif
   
   // we have now moved right one pixel (in the LCD hardware)
   _lcdx++;
 
   
-  // see if we moved from chip 1 to chip 2, or wrapped at end of line
+  // see if we moved on to the next chip, or wrapped at end of line
+#if LCD_WIDTH % 64
+  // (the last chip in the row is only partly used)
+  if (_lcdx >= 64 || (_chip % LCD_CHIPS_ACROSS == LCD_CHIPS_ACROSS - 1 && _lcdx >= LCD_WIDTH % 64))
+#else
   if (_lcdx >= 64)
+#endif
     {
-    if (_chipSelect == LCD_CS1)  // on chip 1, move to chip 2
-      gotoxy (64, _lcdy);
+    const byte x = ((_chip % LCD_CHIPS_ACROSS) << 6) + _lcdx;
+    if (x < LCD_WIDTH)
+      gotoxy (x, _lcdy);      // move to the next chip along
     else
-      gotoxy (0, _lcdy + 8);  // go back to chip 1, down one line
-    }  // if >= 64
+      gotoxy (0, _lcdy + 8);  // go back to the left, down one line
+    }  // if end of chip
   else
     {
 #ifdef WRITETHROUGH_CACHE
@@ -587,51 +654,320 @@ void I2C_graphical_LCD_display::writeData (byte data,
 #endif
     }
   
-}  // end of I2C_graphical_LCD_display::writeData
+}  // end of KS0108_display::putData
 
 
+// no room for a whole character (columns wide) on this line? drop down a line
+// letters are 5 wide (plus a space), so on a 128-pixel line once we are past 122 there isn't room
+void KS0108_display::makeRoom (const byte columns)
+{
+#ifdef LCD_ROTATION
+  if (_orient)
+    {
+    if (_rotX + columns > width ())
+      gotoxy (0, _rotY + 8);
+    return;
+    }
+#endif
+  if (((_chip % LCD_CHIPS_ACROSS) << 6) + _lcdx + columns > LCD_WIDTH)
+    gotoxy (0, _lcdy + 8);
+}  // end of KS0108_display::makeRoom
+
 // write one letter (space to 0x7F), inverted or normal
 
 // Approx time to run: 4 ms on Arduino Uno
-void I2C_graphical_LCD_display::letter (byte c, 
-                                        const boolean inv)
+// (with a Unicode font, c is the code point - so 0xB0 is the degree sign)
+void KS0108_display::letter (byte c, 
+                             const boolean inv)
 {
-  if (c < _fStart || c > (_fStart + _fLength - 1))
-    c = _fStart + _fLength - 1;  // unknown glyph
-  
-  c -= _fStart; // force into range of our font table
-  
-  // no room for a whole character? drop down a line
-  // letters are 5 wide, so once we are past 59, there isn't room before we hit 63
-  if (_lcdx >= (65 - (_fWidth + (_fSpace ? 1 : 0))) && _chipSelect == LCD_CS2)
-    gotoxy (0, _lcdy + 8);
-  
+  drawGlyph (glyphIndex (c), inv);
+}  // end of KS0108_display::letter
+
+// which letter of the font table is for character code
+// (the last one in the table for anything not in the font)
+unsigned int KS0108_display::glyphIndex (const unsigned long code) const
+{
+  if (_uCodes == NULL)
+    {
+    if (code < _fStart || code > (unsigned long) (_fStart + _fLength - 1))
+      return _fLength - 1;  // unknown glyph
+    return code - _fStart;  // force into range of our font table
+    }
+
+  // Unicode font: binary search of its code points
+  unsigned int lo = 0, hi = _fLength;
+  while (lo < hi)
+    {
+    const unsigned int mid = (lo + hi) / 2;
+    if (pgm_read_word (_uCodes + mid) < code)
+      lo = mid + 1;
+    else
+      hi = mid;
+    }
+  if (lo < (unsigned int) _fLength && pgm_read_word (_uCodes + lo) == code)
+    return lo;
+  return _fLength - 1;  // unknown glyph
+}  // end of KS0108_display::glyphIndex
+
+// write letter number index of the font table, moving to the next line first if it won't fit
+void KS0108_display::drawGlyph (const unsigned int index, 
+                                const boolean inv)
+{
+  makeRoom (glyphWidth ());
+
+#ifdef LCD_GLYPH_CACHE
+  // recently drawn letters come from RAM, already inverted
+  const byte * columns = cachedGlyph (index, inv);
+  if (columns)
+    {
+    for (byte x = glyphWidth (); x; x--)
+      writeData (*columns++, false);
+    return;
+    }
+#endif
+
   // font data is in PROGMEM memory (firmware)
+  const byte * p = _fMap + index * _fWidth;
   for (int x = 0; x < _fWidth; x++)
-    writeData (pgm_read_byte (_fMap + (c * _fWidth) + x), inv);
+    writeData (pgm_read_byte (p + x), inv);
   if( _fSpace )
     writeData (0, inv);  // one-pixel gap between letters
 
-}  // end of I2C_graphical_LCD_display::letter
+}  // end of KS0108_display::drawGlyph
+
+// take the next byte of text: with a Unicode font it is UTF-8, so letters may take
+// several bytes; otherwise each byte is a letter
+void KS0108_display::textByte (const byte c, 
+                               const boolean inv)
+{
+  if (_uCodes == NULL)
+    {
+    letter (c, inv);
+    return;
+    }
+
+  if (c < 0x80)
+    {
+    _utf8Left = 0;    // plain ASCII
+    drawGlyph (glyphIndex (c), inv);
+    }
+  else if (c < 0xC0)
+    {
+    // continuation byte (ignored if there was no lead byte)
+    if (_utf8Left)
+      {
+      _utf8Code = (_utf8Code << 6) | (c & 0x3F);
+      if (--_utf8Left == 0)
+        drawGlyph (glyphIndex (_utf8Code), inv);
+      }
+    }
+  else
+    {
+    // lead byte: how many follow
+    if (c < 0xE0)
+      {
+      _utf8Code = c & 0x1F;
+      _utf8Left = 1;
+      }
+    else if (c < 0xF0)
+      {
+      _utf8Code = c & 0x0F;
+      _utf8Left = 2;
+      }
+    else
+      {
+      _utf8Code = c & 0x07;
+      _utf8Left = 3;
+      }
+    }
+}  // end of KS0108_display::textByte
+
+#ifdef LCD_GLYPH_CACHE
+// the columns of letter number index of the font table, from the glyph cache -
+// read in from PROGMEM, in place of the least recently used letter, if not there already
+// returns NULL if the font is too wide to cache
+const byte * KS0108_display::cachedGlyph (const unsigned int index, 
+                                          const boolean inv)
+{
+  if (glyphWidth () > LCD_GLYPH_CACHE_WIDTH)
+    return NULL;
+
+  // start again if the counter wraps round (after 65535 letters)
+  if (++_glyphTick == 0)
+    {
+    for (byte i = 0; i < LCD_GLYPH_CACHE; i++)
+      _glyphs [i].used = 0;
+    _glyphTick = 1;
+    }
+
+  glyphEntry * oldest = _glyphs;
+  for (byte i = 0; i < LCD_GLYPH_CACHE; i++)
+    {
+    glyphEntry * e = &_glyphs [i];
+    if (e->used && e->index == index && e->inv == inv)
+      {
+      e->used = _glyphTick;
+      return e->columns;
+      }
+    if (e->used < oldest->used)
+      oldest = e;
+    }
+
+  // not there - read it in, in place of the oldest
+  const byte mask = inv ? 0xFF : 0;
+  for (int x = 0; x < _fWidth; x++)
+    oldest->columns [x] = pgm_read_byte (_fMap + (index * _fWidth) + x) ^ mask;
+  if (_fSpace)
+    oldest->columns [_fWidth] = mask;  // one-pixel gap between letters
+
+  oldest->index = index;
+  oldest->inv = inv;
+  oldest->used = _glyphTick;
+  return oldest->columns;
+}  // end of KS0108_display::cachedGlyph
+#endif  // LCD_GLYPH_CACHE
+
+// one column of a letter in the current font, as letter() would draw it (not inverted)
+// col runs from 0 to glyphWidth () - 1; the gap after the letter is blank
+byte KS0108_display::glyphColumn (byte c, 
+                                  const byte col) const
+{
+  if (col >= _fWidth)
+    return 0;
+
+  return pgm_read_byte (_fMap + (glyphIndex (c) * _fWidth) + col);
+}  // end of KS0108_display::glyphColumn
 
 // write an entire null-terminated string to the LCD: inverted or normal
-void I2C_graphical_LCD_display::string (const char * s, 
-                                        const boolean inv)
+// (UTF-8 with a Unicode font)
+void KS0108_display::string (const char * s, 
+                             const boolean inv)
 {
   char c;
   while ((c = *(s++)))
-    letter (c, inv); 
-}  // end of I2C_graphical_LCD_display::string
+    textByte (c, inv); 
+}  // end of KS0108_display::string
 
 // blits (copies) a series of bytes to the LCD display from an array in PROGMEM
 
 // Approx time to run: 2 ms/byte on Arduino Uno
-void I2C_graphical_LCD_display::blit (const byte * pic, 
-                                      const unsigned int size)
+void KS0108_display::blit (const byte * pic, 
+                           const unsigned int size)
 {
   for (unsigned int x = 0; x < size; x++, pic++)
     writeData (pgm_read_byte (pic));
-}  // end of I2C_graphical_LCD_display::blit
+}  // end of KS0108_display::blit
+
+// blits a picture run-length encoded by ks0108conv -z (see extras), from PROGMEM
+// size is the number of bytes once unpacked, as for blit
+// each block starts with a count byte: 0x80 + n is the next byte repeated n + 1 times,
+// anything else, n, is followed by n + 1 bytes to copy as they are
+void KS0108_display::blitRLE (const byte * pic, 
+                              unsigned int size)
+{
+  while (size)
+    {
+    byte count = pgm_read_byte (pic++);
+    const boolean run = count & 0x80;
+
+    count = (count & 0x7F) + 1;
+    if (count > size)
+      count = size;
+    size -= count;
+
+    if (run)
+      {
+      const byte b = pgm_read_byte (pic++);
+      while (count--)
+        writeData (b);
+      }
+    else
+      while (count--)
+        writeData (pgm_read_byte (pic++));
+    }
+}  // end of KS0108_display::blitRLE
+
+// 8x8 ordered dither (Bayer) matrix - each entry times 4, plus 2, is the threshold
+// below which a gray pixel is drawn black
+static const byte bayer8 [8] [8] PROGMEM = {
+  {  0, 32,  8, 40,  2, 34, 10, 42 },
+  { 48, 16, 56, 24, 50, 18, 58, 26 },
+  { 12, 44,  4, 36, 14, 46,  6, 38 },
+  { 60, 28, 52, 20, 62, 30, 54, 22 },
+  {  3, 35, 11, 43,  1, 33,  9, 41 },
+  { 51, 19, 59, 27, 49, 17, 57, 25 },
+  { 15, 47,  7, 39, 13, 45,  5, 37 },
+  { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+// draw an 8-bit grayscale picture with its top-left corner at x,y, dithering it to
+// black and white as it goes with the ordered pattern above
+// the pattern is lined up with the screen, not the picture, so pictures side by side match up
+// whole pages are written straight out; where the picture only covers part of a page,
+// the rest of that page is read back and kept
+void KS0108_display::drawGrayImage (const byte x,
+                                    const byte y,
+                                    const byte w,
+                                    const byte h,
+                                    const byte * pic)
+{
+  if (x >= width () || y >= height ())
+    return;
+
+  // clip to the screen
+  const byte cols = (w > width () - x) ? width () - x : w;
+  const int bottom = (y + h > height ()) ? height () : y + h;
+  const byte * pattern = &bayer8 [0] [0];
+
+  for (int top = y & ~7; top < bottom; top += 8)
+    {
+    // which bits of this page the picture covers
+    byte mask = 0xFF;
+    if (top < y)
+      mask &= 0xFF << (y - top);
+    if (top + 8 > bottom)
+      mask &= 0xFF >> (top + 8 - bottom);
+
+    gotoxy (x, top);
+
+    for (byte col = 0; col < cols; col++)
+      {
+      byte bits = 0;
+      const byte across = (x + col) & 7;
+
+      for (byte i = 0; i < 8; i++)
+        if (mask & (1 << i))
+          {
+          const byte v = pgm_read_byte (pic + (unsigned int) (top + i - y) * w + col);
+          if (v < (pgm_read_byte (pattern + (((top + i) & 7) << 3) + across) << 2) + 2)
+            bits |= 1 << i;
+          }
+
+      if (mask == 0xFF)
+        {
+        writeData (bits);
+        continue;
+        }
+
+      // only part of the page is picture: invert and combine just those bits (as writeData
+      // would the whole byte), and put the rest back as it was
+      if (_invmode)
+        bits ^= mask;
+      const byte old = readData ();
+#ifndef WRITETHROUGH_CACHE
+      // go back to that place (because readData() moved it)
+      gotoxy (x + col, top);
+#endif
+      switch (_drawMode)
+        {
+        case LCD_MODE_SET:   bits |= old;  break;
+        case LCD_MODE_CLEAR: bits = old & ~bits; break;
+        case LCD_MODE_XOR:   bits ^= old;  break;
+        }
+      putData ((old & ~mask) | (bits & mask));
+      }
+    }
+}  // end of KS0108_display::drawGrayImage
 
 // clear rectangle x1,y1,x2,y2 (inclusive) to val (eg. 0x00 for black, 0xFF for white)
 // default is entire screen to black
@@ -639,12 +975,18 @@ void I2C_graphical_LCD_display::blit (const byte * pic,
 // this if faster than lcd_fill_rect because it doesn't read from the display
 
 // Approx time to run: 120 ms on Arduino Uno for 20 x 50 pixel rectangle
-void I2C_graphical_LCD_display::clear (const byte x1,    // start pixel
-                                       const byte y1,     
-                                       const byte x2,  // end pixel
-                                       const byte y2,   
-                                       const byte val)   // what to fill with 
+void KS0108_display::clear (const byte x1,    // start pixel
+                            const byte y1,     
+                            byte x2,  // end pixel
+                            byte y2,   
+                            const byte val)   // what to fill with 
 {
+  // stop at the edge of the screen
+  if (x2 > lastX ())
+    x2 = lastX ();
+  if (y2 > lastY ())
+    y2 = lastY ();
+
   for (byte y = y1; y <= y2; y += 8)
     {
     gotoxy (x1, y);
@@ -653,99 +995,500 @@ void I2C_graphical_LCD_display::clear (const byte x1,    // start pixel
     } // end of for y
   
   gotoxy (x1, y1);
-} // end of I2C_graphical_LCD_display::clear
-
-// set or clear a pixel at x,y
-// warning: this is slow because we have to read the existing pixel in from the LCD display
-// so we can change a single bit in it
-void I2C_graphical_LCD_display::setPixel (const byte x, 
-                                          const byte y, 
-                                          const byte val)
-{
-	if (x < 128 && y < 64)
-	{
-	  // select appropriate page and byte
-	  gotoxy (x, y);
-
-	  // get existing pixel values
-	  byte c = readData ();
-	  
-	  // toggle or clear this particular one as required
-	  if (val)
-		c |=   1 << (y & 7);    // set pixel
-	  else
-		c &= ~(1 << (y & 7));   // clear pixel
-	  
-	#ifndef WRITETHROUGH_CACHE
-	  // go back to that place (because readData() moved it)
-	  gotoxy (x, y);
-	#endif
-
-	  // write changed data back
-	  writeData (c);
-	} 
-}  // end of I2C_graphical_LCD_display::setPixel
-
-// fill the rectangle x1,y1,x2,y2 (inclusive) with black (1) or white (0)
-// if possible use lcd_clear instead because it is much faster
-// however lcd_clear clears batches of 8 vertical pixels
-
-// Approx time to run: 5230 ms on Arduino Uno for 20 x 50 pixel rectangle
-//    (Yep, that's over 5 seconds!)
-void I2C_graphical_LCD_display::fillRect (const byte x1, // start pixel
-                                          const byte y1,     
-                                          const byte x2, // end pixel
-                                          const byte y2,    
-                                          const byte val)  // what to draw (0 = white, 1 = black) 
+} // end of KS0108_display::clear
+
+// invert (black to white and white to black) the rectangle x1,y1,x2,y2 (inclusive)
+// default is the entire screen
+// unlike fillRect in LCD_MODE_XOR this works a byte (8 pixels down) at a time,
+// so it is about as fast as clear - handy for highlighting a menu line
+void KS0108_display::invertRect (const byte x1,    // start pixel
+                                 const byte y1,
+                                 byte x2,  // end pixel
+                                 byte y2)
 {
-  for (byte y = y1; y <= y2; y++)
-	for (byte x = x1; x <= x2; x++)
-      setPixel (x, y, val);
-}  // end of I2C_graphical_LCD_display::fillRect
+  // stop at the edge of the screen
+  if (x2 > lastX ())
+    x2 = lastX ();
+  if (y2 > lastY ())
+    y2 = lastY ();
+  if (x1 > x2 || y1 > y2)
+    return;
 
-// frame the rectangle x1,y1,x2,y2 (inclusive) with black (1) or white (0)
-// width is width of frame, frames grow inwards
+  for (int top = y1 & ~7; top <= y2; top += 8)
+    {
+    // which of the 8 pixels down in this line are inside the rectangle
+    byte mask = 0xFF;
+    if (top < y1)
+      mask &= 0xFF << (y1 & 7);
+    if (top + 7 > y2)
+      mask &= 0xFF >> (7 - (y2 & 7));
+
+    gotoxy (x1, top);
+    for (byte x = x1; x <= x2; x++)
+      {
+      const byte c = readData ();
+#ifndef WRITETHROUGH_CACHE
+      // go back to that place (because readData() moved it)
+      gotoxy (x, top);
+#endif
+#ifdef LCD_GRAYSCALE
+      // keep the gray levels (inverted too) - putData() sets both planes
+      const int offset = _cacheOffset;
+      const byte lo = _plane [offset] ^ mask;
+#endif
+      putData (c ^ mask);
+#ifdef LCD_GRAYSCALE
+      _plane [offset] = lo;
+#endif
+      }  // end of for x
+    }  // end of for each line
 
-// Approx time to run:  730 ms on Arduino Uno for 20 x 50 pixel rectangle with 1-pixel wide border
-//             1430 ms on Arduino Uno for 20 x 50 pixel rectangle with 2-pixel wide border
-void I2C_graphical_LCD_display::frameRect (const byte x1, // start pixel
-                                           const byte y1,     
-                                           const byte x2, // end pixel
-                                           const byte y2,    
-                                           const byte val,    // what to draw (0 = white, 1 = black) 
-                                           const byte width)
-{
-  byte x, y, i;
-  
-  // top and bottom lines
-  for (x = x1; x <= x2; x++)
-    for (i = 0; i < width; i++)
-	{
-      setPixel (x, y1 + i, val);
-      setPixel (x, y2 - i, val);
-    }
-  
-  // left and right lines
-  for (y = y1; y <= y2; y++)
-    for (i = 0; i < width; i++)
-	{
-      setPixel (x1 + i, y, val);
-      setPixel (x2 - i, y, val);
-    }
-  
-}  // end of I2C_graphical_LCD_display::frameRect
+  gotoxy (x1, y1);
+}  // end of KS0108_display::invertRect
 
-// draw a line from x1,y1 to x2,y2 (inclusive) with black (1) or white (0)
-// Warning: fairly slow, as is anything that draws individual pixels
-void I2C_graphical_LCD_display::line  (const byte x1,  // start pixel
-                                       const byte y1,     
-                                       const byte x2,  // end pixel
-                                       const byte y2,   
-                                       const byte val)  // what to draw (0 = white, 1 = black) 
+// the byte at x, line page (8 pixels down) as we are drawing - straight from the cache
+// if there is one, so nothing is sent to the LCD
+byte KS0108_display::peekData (const byte x, 
+                               const byte page)
 {
-  byte x, y;
-  
-  // vertical line? do quick way
+#if defined(WRITETHROUGH_CACHE)
+#ifdef LCD_ROTATION
+  if (_orient)
+    {
+    gotoxy (x, page << 3);   // (only remembers where we are)
+    return readRotated ();
+    }
+#endif
+  const byte chip = (page >> 3) * LCD_CHIPS_ACROSS + (x >> 6);
+  return _cache [(chip << 9) + ((x & 63) << 3) + (page & 7)];
+#else
+  gotoxy (x, page << 3);
+  return readData ();
+#endif
+}  // end of KS0108_display::peekData
+
+// the 8 pixels down from row top (which may be above the screen) in column x, as a byte
+byte KS0108_display::peekRows (const byte x, 
+                               const int top)
+{
+  const int page = top >= 0 ? top >> 3 : - ((7 - top) >> 3);   // rounded down
+  const byte shift = top - (page << 3);
+  const int lines = height () >> 3;
+
+  unsigned int both = 0;
+  if (page >= 0 && page < lines)
+    both = peekData (x, page);
+  if (shift && page + 1 >= 0 && page + 1 < lines)
+    both |= peekData (x, page + 1) << 8;
+  return both >> shift;
+}  // end of KS0108_display::peekRows
+
+// copy the w x h pixels at sx,sy to dx,dy (top-left corners) - they may overlap, so
+// this can move part of the screen along (eg. a chart, one column left each sample)
+// pixels are copied as they are (drawing mode and inverse don't apply), and any part that
+// would go off the screen is left out; clear what is left behind yourself if need be
+// fastest with WRITETHROUGH_CACHE, when only the destination is sent, a line at a time
+void KS0108_display::copyRect (const byte sx,
+                               const byte sy,
+                               byte w,
+                               byte h,
+                               const byte dx,
+                               const byte dy)
+{
+  // stop at the edges of the screen
+  if (sx >= width () || dx >= width () || sy >= height () || dy >= height ())
+    return;
+  if (w > width () - sx)
+    w = width () - sx;
+  if (w > width () - dx)
+    w = width () - dx;
+  if (h > height () - sy)
+    h = height () - sy;
+  if (h > height () - dy)
+    h = height () - dy;
+  if (w == 0 || h == 0)
+    return;
+
+  const int down = dy - sy;    // how far it moves
+  const byte firstPage = dy >> 3;
+  const byte lastPage = (dy + h - 1) >> 3;
+
+  // work from the end it is moving towards, so nothing is overwritten before it is copied:
+  // lines from the bottom up if moving down, columns from the right if moving right
+  for (byte i = 0; i <= lastPage - firstPage; i++)
+    {
+    const byte page = down > 0 ? lastPage - i : firstPage + i;
+    const int top = page << 3;
+
+    // which of the 8 pixels down in this line are inside the destination
+    byte mask = 0xFF;
+    if (top < dy)
+      mask &= 0xFF << (dy & 7);
+    if (top + 7 > dy + h - 1)
+      mask &= 0xFF >> (7 - ((dy + h - 1) & 7));
+
+    // a batch of columns at a time: work them all out, then send them in one go
+    for (byte done = 0; done < w; )
+      {
+      byte batch [32];
+      const byte count = w - done < (int) sizeof batch ? w - done : sizeof batch;
+      const byte left = dx > sx ? dx + w - done - count : dx + done;
+
+      for (byte j = 0; j < count; j++)
+        {
+        const byte x = left + j;
+        byte c = peekRows (x - dx + sx, top - down);
+        if (mask != 0xFF)
+          c = (peekData (x, page) & ~mask) | (c & mask);   // keep the pixels outside
+        batch [j] = c;
+        }
+
+      gotoxy (left, top);
+      for (byte j = 0; j < count; j++)
+        putData (batch [j]);
+      done += count;
+      }  // end of for each batch
+    }  // end of for each line
+
+  gotoxy (dx, dy);
+}  // end of KS0108_display::copyRect
+
+// does peekData () move where we are writing? (if so, go back before writing)
+boolean KS0108_display::peekMoves () const
+{
+#if !defined(WRITETHROUGH_CACHE)
+  return true;    // it reads the LCD
+#elif defined(LCD_ROTATION)
+  return _orient != 0;
+#else
+  return false;
+#endif
+}  // end of KS0108_display::peekMoves
+
+// scroll the columns x1 to x2 (inclusive) of the lines y1 to y2 (forced to 8-pixel lines, as for clear)
+// dx pixels right (or left, if negative), bringing in new columns at the edge they leave:
+// columns holds them for each line in turn, dx bytes (left to right) for each line - as for blit -
+// or NULL to bring in blank columns
+// each line is sent in one run from x1 to x2 (across the chips), so with WRITETHROUGH_CACHE it
+// costs one gotoxy and a byte per column - a strip chart or ticker can go at its sample rate
+void KS0108_display::scrollRegion (const byte x1,
+                                   const byte y1,
+                                   byte x2,
+                                   byte y2,
+                                   const int dx,
+                                   const byte * columns)
+{
+  // stop at the edge of the screen
+  if (x2 > lastX ())
+    x2 = lastX ();
+  if (y2 > lastY ())
+    y2 = lastY ();
+  if (x1 > x2 || y1 > y2)
+    return;
+
+  const byte w = x2 - x1 + 1;
+  const int n = dx < 0 ? -dx : dx;    // how many columns it moves
+  if (n > LCD_SCROLL_MAX && n < w && dx > 0)
+    {
+    // too far to keep track of as we go - move it the slow way, then bring in the new columns
+    copyRect (x1, y1 & ~7, w - n, (y2 | 7) - (y1 & ~7) + 1, x1 + n, y1 & ~7);
+    scrollRegion (x1, y1, x1 + n - 1, y2, n, columns);
+    return;
+    }
+
+  byte line = 0;    // counting from y1 - for columns
+  for (int top = y1 & ~7; top <= y2; top += 8, line++)
+    {
+    byte old [LCD_SCROLL_MAX];   // the last n columns, before they were overwritten
+    const byte page = top >> 3;
+
+    gotoxy (x1, top);
+    for (byte i = 0; i < w; i++)
+      {
+      const byte x = x1 + i;
+      boolean peeked = false;
+      byte c;
+
+      if (dx <= 0)
+        {
+        // moving left: from n columns to the right, or new on the right-hand end
+        if (i + n < w)
+          {
+          c = peekData (x + n, page);
+          peeked = true;
+          }
+        else
+          c = columns ? columns [line * n + i + n - w] : 0;
+        }
+      else
+        {
+        // moving right: new on the left-hand end, or from n columns to the left
+        if (i < n)
+          c = columns ? columns [line * n + i] : 0;
+        else
+          c = old [i % n];
+        if (i + n < w)
+          {
+          old [i % n] = peekData (x, page);    // wanted n columns further on
+          peeked = true;
+          }
+        }
+
+      if (peeked && peekMoves ())
+        gotoxy (x, top);    // go back (peekData moved us)
+      putData (c);
+      }  // end of for each column
+    }  // end of for each line
+
+  gotoxy (x1, y1);
+}  // end of KS0108_display::scrollRegion
+
+// copy columns x1 to x2 of the lines y1 to y2 (forced to 8-pixel lines) into buffer, a line at a time
+// (as for blit) - or with no buffer, onto the end of the region arena
+boolean KS0108_display::saveRegion (const byte x1,
+                                    const byte y1,
+                                    byte x2,
+                                    byte y2,
+                                    byte * buffer)
+{
+  // stop at the edge of the screen
+  if (x2 > lastX ())
+    x2 = lastX ();
+  if (y2 > lastY ())
+    y2 = lastY ();
+  if (x1 > x2 || y1 > y2)
+    return false;
+
+  if (buffer == NULL)
+    {
+#ifdef LCD_REGION_ARENA
+    const unsigned int size = LCD_REGION_SIZE (x1, y1, x2, y2);
+    if (size > LCD_REGION_ARENA - _arenaUsed)
+      return false;   // no room
+    buffer = &_arena [_arenaUsed];
+    _arenaUsed += size;
+#else
+    return false;
+#endif
+    }
+
+  for (int top = y1 & ~7; top <= y2; top += 8)
+    for (byte x = x1; x <= x2; x++)
+      *buffer++ = peekData (x, top >> 3);
+
+  return true;
+}  // end of KS0108_display::saveRegion
+
+// put back a region saved by saveRegion (the same x1, y1, x2, y2) - each line is sent in one run
+// with no buffer, it is the region saved last in the arena, which is then free again
+boolean KS0108_display::restoreRegion (const byte x1,
+                                       const byte y1,
+                                       byte x2,
+                                       byte y2,
+                                       const byte * buffer)
+{
+  // stop at the edge of the screen
+  if (x2 > lastX ())
+    x2 = lastX ();
+  if (y2 > lastY ())
+    y2 = lastY ();
+  if (x1 > x2 || y1 > y2)
+    return false;
+
+  if (buffer == NULL)
+    {
+#ifdef LCD_REGION_ARENA
+    const unsigned int size = LCD_REGION_SIZE (x1, y1, x2, y2);
+    if (size > _arenaUsed)
+      return false;   // not that much saved
+    _arenaUsed -= size;
+    buffer = &_arena [_arenaUsed];
+#else
+    return false;
+#endif
+    }
+
+  for (int top = y1 & ~7; top <= y2; top += 8)
+    {
+    gotoxy (x1, top);
+    for (byte x = x1; x <= x2; x++)
+      putData (*buffer++);
+    }
+
+  gotoxy (x1, y1);
+  return true;
+}  // end of KS0108_display::restoreRegion
+
+// set or clear a pixel at x,y
+// warning: this is slow because we have to read the existing pixel in from the LCD display
+// so we can change a single bit in it
+void KS0108_display::setPixel (const byte x, 
+                               const byte y, 
+                               const byte val)
+{
+	if (x < width () && y < height ())
+	  changeBits (x, y, 1 << (y & 7), val);
+}  // end of KS0108_display::setPixel
+
+// set or clear (as the drawing mode says) the pixels in mask, of the byte at x,y (8 pixels down)
+// - one read and one write, however many of them there are
+// only the pixels in pattern are drawn - in LCD_MODE_COPY the rest of mask is cleared
+void KS0108_display::changeBits (const byte x, 
+                                 const byte y, 
+                                 const byte mask,
+                                 const byte val,
+                                 const byte pattern)
+{
+  // select appropriate page and byte
+  gotoxy (x, y);
+
+  // get existing pixel values
+  byte c = readData ();
+
+#ifdef LCD_GRAYSCALE
+  // putData() sets the whole byte in the second plane - only these pixels should change
+  const int offset = _cacheOffset;
+  const byte lo = _plane [offset];
+#endif
+  
+  // set, clear or toggle these particular ones as required
+  switch (_drawMode)
+    {
+    case LCD_MODE_SET:   if (val) c |= mask & pattern;    break;
+    case LCD_MODE_CLEAR: if (val) c &= ~(mask & pattern); break;
+    case LCD_MODE_XOR:   if (val) c ^= mask & pattern;    break;
+    default:             // copy
+      c &= ~mask;     // clear pixels
+      if (val)
+        c |= mask & pattern;    // set pixels
+      break;
+    }
+  
+#ifndef WRITETHROUGH_CACHE
+  // go back to that place (because readData() moved it)
+  gotoxy (x, y);
+#endif
+
+  // write changed data back (as it is - the mode has been dealt with)
+  putData (c);
+
+#ifdef LCD_GRAYSCALE
+  _plane [offset] = (lo & ~mask) | (c & mask);
+#endif
+}  // end of KS0108_display::changeBits
+
+// fill the rectangle x1,y1,x2,y2 (inclusive) with black (1) or white (0), in the fill pattern
+// each byte (8 pixels down) is read and written once, so it is nearly as fast as clear
+// (which doesn't read the screen, but clears batches of 8 vertical pixels)
+void KS0108_display::fillRect (const byte x1, // start pixel
+                               const byte y1,     
+                               byte x2, // end pixel
+                               byte y2,    
+                               const byte val)  // what to draw (0 = white, 1 = black) 
+{
+  // stop at the edge of the screen
+  if (x2 > lastX ())
+    x2 = lastX ();
+  if (y2 > lastY ())
+    y2 = lastY ();
+
+  for (byte x = x1; x <= x2; x++)
+    fillColumn (x, y1, y2, val);
+}  // end of KS0108_display::fillRect
+
+// fill column x from y1 down to y2 (inclusive, already on the screen) in the fill pattern
+void KS0108_display::fillColumn (const byte x, 
+                                 const byte y1, 
+                                 const byte y2, 
+                                 const byte val)
+{
+  for (int y = y1 & ~7; y <= y2; y += 8)
+    {
+    // which of the 8 pixels down in this line are inside
+    byte mask = 0xFF;
+    if (y < y1)
+      mask &= 0xFF << (y1 & 7);
+    if (y + 7 > y2)
+      mask &= 0xFF >> (7 - (y2 & 7));
+    changeBits (x, y, mask, val, _pattern [x & 7]);
+    }
+}  // end of KS0108_display::fillColumn
+
+// the fill patterns for setPattern, each 8 columns of 8 pixels down (bit 0 at the top)
+static const byte fillPatterns [] [8] PROGMEM = {
+  { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF },   // LCD_PATTERN_SOLID
+  { 0x11, 0x00, 0x44, 0x00, 0x11, 0x00, 0x44, 0x00 },   // LCD_PATTERN_12
+  { 0x55, 0x00, 0xAA, 0x00, 0x55, 0x00, 0xAA, 0x00 },   // LCD_PATTERN_25
+  { 0x55, 0xAA, 0x55, 0xAA, 0x55, 0xAA, 0x55, 0xAA },   // LCD_PATTERN_50
+  { 0xAA, 0xFF, 0x55, 0xFF, 0xAA, 0xFF, 0x55, 0xFF },   // LCD_PATTERN_75
+  { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11 },   // LCD_PATTERN_HORIZONTAL
+  { 0xFF, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00 },   // LCD_PATTERN_VERTICAL
+  { 0x11, 0x22, 0x44, 0x88, 0x11, 0x22, 0x44, 0x88 },   // LCD_PATTERN_DIAGONAL
+  { 0x88, 0x44, 0x22, 0x11, 0x88, 0x44, 0x22, 0x11 },   // LCD_PATTERN_BACKDIAGONAL
+  { 0x99, 0x66, 0x66, 0x99, 0x99, 0x66, 0x66, 0x99 },   // LCD_PATTERN_CROSSHATCH
+};
+
+// choose one of the fill patterns above (anything else is solid)
+void KS0108_display::setPattern (byte which)
+{
+  if (which >= sizeof fillPatterns / sizeof fillPatterns [0])
+    which = LCD_PATTERN_SOLID;
+  for (byte x = 0; x < 8; x++)
+    _pattern [x] = pgm_read_byte (&fillPatterns [which] [x]);
+}  // end of KS0108_display::setPattern
+
+// use a fill pattern of 8 columns (8 bytes in RAM, bit 0 at the top of each) - NULL for solid
+void KS0108_display::setUserPattern (const byte * columns)
+{
+  if (columns == NULL)
+    {
+    setPattern (LCD_PATTERN_SOLID);
+    return;
+    }
+  memcpy (_pattern, columns, sizeof _pattern);
+}  // end of KS0108_display::setUserPattern
+
+// frame the rectangle x1,y1,x2,y2 (inclusive) with black (1) or white (0)
+// width is width of frame, frames grow inwards
+
+// Approx time to run:  730 ms on Arduino Uno for 20 x 50 pixel rectangle with 1-pixel wide border
+//             1430 ms on Arduino Uno for 20 x 50 pixel rectangle with 2-pixel wide border
+void KS0108_display::frameRect (const byte x1, // start pixel
+                                const byte y1,     
+                                byte x2, // end pixel
+                                byte y2,    
+                                const byte val,    // what to draw (0 = white, 1 = black) 
+                                const byte width)
+{
+  // stop at the edge of the screen
+  if (x2 > lastX ())
+    x2 = lastX ();
+  if (y2 > lastY ())
+    y2 = lastY ();
+  
+  // each pixel of the frame is drawn once, so it also works in LCD_MODE_XOR
+  for (int y = y1; y <= y2; y++)
+    {
+    // top and bottom lines go all the way across
+    const boolean across = y - y1 < width || y2 - y < width;
+    for (int x = x1; x <= x2; x++)
+      if (across || x - x1 < width || x2 - x < width)   // otherwise just the left and right lines
+        setPixel (x, y, val);
+    }
+  
+}  // end of KS0108_display::frameRect
+
+// draw a line from x1,y1 to x2,y2 (inclusive) with black (1) or white (0)
+// Warning: fairly slow, as is anything that draws individual pixels
+void KS0108_display::line  (const byte x1,  // start pixel
+                            const byte y1,     
+                            const byte x2,  // end pixel
+                            const byte y2,   
+                            const byte val)  // what to draw (0 = white, 1 = black) 
+{
+  byte x, y;
+  
+  // vertical line? do quick way
   if (x1 == x2)
     {
     for (y = y1; y <= y2; y++)
@@ -799,55 +1542,183 @@ void I2C_graphical_LCD_display::line  (const byte x1,  // start pixel
 	setPixel(x2, y2, val);
   
   
-} // end of I2C_graphical_LCD_display::line
+} // end of KS0108_display::line
+
+// a / b rounded to the nearest whole number (b > 0)
+static int roundedDiv (const long a, 
+                       const int b)
+{
+  return a >= 0 ? (a + b / 2) / b : - ((- a + b / 2) / b);
+}  // end of roundedDiv
+
+// turn on the rows from y1 to y2 (either way round) in bits, one byte for each line of 8 pixels
+static void polygonSpan (byte * bits, 
+                         const byte lines,
+                         int y1, 
+                         int y2)
+{
+  if (y1 > y2)
+    {
+    const int y = y1;
+    y1 = y2;
+    y2 = y;
+    }
+  if (y1 < 0)
+    y1 = 0;
+  if (y2 > lines * 8 - 1)
+    y2 = lines * 8 - 1;
+
+  for (int y = y1 & ~7; y <= y2; y += 8)
+    {
+    byte mask = 0xFF;
+    if (y < y1)
+      mask &= 0xFF << (y1 & 7);
+    if (y + 7 > y2)
+      mask &= 0xFF >> (7 - (y2 & 7));
+    bits [y >> 3] |= mask;
+    }
+}  // end of polygonSpan
+
+// flip the rows from y down to the bottom in bits - two of these leave the span between them
+static void polygonCrossing (byte * bits, 
+                             const byte lines,
+                             const int y)
+{
+  for (byte line = 0; line < lines; line++)
+    {
+    const int top = line * 8;
+    if (y <= top)
+      bits [line] ^= 0xFF;
+    else if (y < top + 8)
+      bits [line] ^= 0xFF << (y - top);
+    }
+}  // end of polygonCrossing
+
+// fill the polygon with count corners: points holds x, y of the first corner, then x, y of the next
+// and so on (corners may be off the screen); the outline is filled too, and shapes that are concave or
+// cross themselves are filled even-odd
+// it works down each column in turn, changing each byte (8 pixels down) once, so it is much faster
+// than filling with lines or fillRect, and works in LCD_MODE_XOR
+void KS0108_display::fillPolygon (const int * points,
+                                  const byte count,
+                                  const byte val)
+{
+  if (count == 0)
+    return;
+
+  // which columns it covers
+  int left = points [0], right = points [0];
+  for (byte i = 1; i < count; i++)
+    {
+    if (points [i * 2] < left)
+      left = points [i * 2];
+    if (points [i * 2] > right)
+      right = points [i * 2];
+    }
+  if (left < 0)
+    left = 0;
+  if (right > lastX ())
+    right = lastX ();
+
+  const byte lines = (lastY () >> 3) + 1;
+
+  for (int x = left; x <= right; x++)
+    {
+    byte inside [(LCD_WIDTH > LCD_HEIGHT ? LCD_WIDTH : LCD_HEIGHT) / 8];  // between the edges
+    byte edges [sizeof inside];   // the pixels the edges go through
+    memset (inside, 0, sizeof inside);
+    memset (edges, 0, sizeof edges);
+
+    for (byte i = 0; i < count; i++)
+      {
+      // the edge from this corner to the next, left to right
+      const byte next = i + 1 < count ? i + 1 : 0;
+      int xa = points [i * 2], ya = points [i * 2 + 1];
+      int xb = points [next * 2], yb = points [next * 2 + 1];
+      if (xa > xb)
+        {
+        xa = points [next * 2];
+        ya = points [next * 2 + 1];
+        xb = points [i * 2];
+        yb = points [i * 2 + 1];
+        }
+      if (x < xa || x > xb)
+        continue;   // not in this column
+
+      if (xa == xb)
+        {
+        polygonSpan (edges, lines, ya, yb);   // straight down
+        continue;
+        }
+
+      const int dx = xb - xa;
+      const int dy = yb - ya;
+
+      // where it crosses the middle of the column (counting the left end but not the right,
+      // so a corner where the outline carries on is only counted once)
+      if (x < xb)
+        polygonCrossing (inside, lines, ya + roundedDiv ((long) (x - xa) * dy, dx));
+
+      // and the rows it goes through, from half a pixel left of that to half a pixel right
+      const int from = x > xa ? (x - xa) * 2 - 1 : 0;
+      const int to = x < xb ? (x - xa) * 2 + 1 : dx * 2;
+      polygonSpan (edges, lines, ya + roundedDiv ((long) from * dy, dx * 2),
+                                 ya + roundedDiv ((long) to * dy, dx * 2));
+      }  // end of for each edge
+
+    for (byte line = 0; line < lines; line++)
+      if (inside [line] | edges [line])
+        changeBits (x, line << 3, inside [line] | edges [line], val, _pattern [x & 7]);
+    }  // end of for each column
+}  // end of KS0108_display::fillPolygon
+
+// fill the triangle with corners x1,y1 x2,y2 and x3,y3 (which may be off the screen)
+void KS0108_display::fillTriangle (const int x1,
+                                   const int y1,
+                                   const int x2,
+                                   const int y2,
+                                   const int x3,
+                                   const int y3,
+                                   const byte val)
+{
+  const int points [6] = { x1, y1, x2, y2, x3, y3 };
+  fillPolygon (points, 3, val);
+}  // end of KS0108_display::fillTriangle
 
 // set scroll position to y
-void I2C_graphical_LCD_display::scroll (const byte y)   // set scroll position
+// (each chip scrolls its own 64 rows, so on a 128-pixel high panel the two halves scroll separately)
+void KS0108_display::scroll (const byte y)   // set scroll position
 {
   if (y < 64)
   {
 	  byte old_cs = _chipSelect;
-	  _chipSelect = LCD_CS1;
-	  cmd (LCD_DISP_START | (y & 0x3F) );  // set scroll position
-	  _chipSelect = LCD_CS2;
-	  cmd (LCD_DISP_START | (y & 0x3F) );  // set scroll position
+	  for (byte chip = 0; chip < LCD_CHIPS; chip++)
+	  {
+		  _chipSelect = lcdChipSelect [chip];
+		  cmd (LCD_DISP_START | (y & 0x3F) );  // set scroll position
+	  }
 	  _chipSelect = old_cs;
   }
-} // end of I2C_graphical_LCD_display::scroll
+} // end of KS0108_display::scroll
 
 // BRR 03-Dec-2016
 
 //	Draw an open circle with center (x0,y0) and radius r in color val
 //	Uses midpoint algorithm - compute one octant and reflect it 7 times
-void I2C_graphical_LCD_display::circle (const byte x0,		// center point x
+void KS0108_display::circle (const byte x0,		// center point x
 		   const byte y0,		// center point y
 		   const byte r,		// radius
 		   const byte val)		// color (0 = white, 1 = black)
 {
-	byte x = r;
-	byte y = 0;
+	int x = r;		// (int, so a radius of 0 doesn't wrap round)
+	int y = 0;
 	int err = 0;
 
 	while(x >= y)
 	{
-		setPixel(x0 + x, y0 + y, val);
-		setPixel(x0 + y, y0 + x, val);
-		if (y <= x0)
-		{
-			setPixel(x0 - y, y0 + x, val);
-			if (x <= y0)
-				setPixel(x0 - y, y0 - x, val);
-		}
-		if (x <= x0)
-		{
-			setPixel(x0 - x, y0 + y, val);
-			if (y <= y0)
-				setPixel(x0 - x, y0 - y, val);
-		}
-		if (x <= y0)
-			setPixel(x0 + y, y0 - x, val);
-		if (y <= y0)
-			setPixel(x0 + x, y0 - y, val);
+		circlePoints(x0, y0, x, y, val);
+		if (x != y)		// on the diagonal the reflection is the same point
+			circlePoints(x0, y0, y, x, val);
 		
 		++y;
 		err += 1 + 2*y;
@@ -859,38 +1730,48 @@ void I2C_graphical_LCD_display::circle (const byte x0,		// center point x
 	}
 }  // circle
 
-//	Draw a filled circle with center (x0,y0) and radius r in color val
+//	Plot the (up to) four points x0 +/- dx, y0 +/- dy, each once (so XOR mode works)
+void KS0108_display::circlePoints (const byte x0,
+											  const byte y0,
+											  const byte dx,
+											  const byte dy,
+											  const byte val)
+{
+	setPixel(x0 + dx, y0 + dy, val);
+	if (dx && dx <= x0)
+		setPixel(x0 - dx, y0 + dy, val);
+	if (dy && dy <= y0)
+	{
+		setPixel(x0 + dx, y0 - dy, val);
+		if (dx && dx <= x0)
+			setPixel(x0 - dx, y0 - dy, val);
+	}
+}  // circlePoints
+
+//	Draw a filled circle with center (x0,y0) and radius r in color val, in the fill pattern
 //	Adaptation of midpoint algorithm - fill a circle by
-//	drawing lines between horizontally opposing octants
-void I2C_graphical_LCD_display::fillCircle (const byte x0,		// center point x
+//	drawing columns between vertically opposing octants
+void KS0108_display::fillCircle (const byte x0,		// center point x
 											  const byte y0,		// center point y
 											  const byte r,			// radius
 											  const byte val)		// color (0 = white, 1 = black)
 {
-	byte x = r;
-	byte y = 0;
+	int x = r;		// (int, so a radius of 0 doesn't wrap round)
+	int y = 0;
 	int err = 0;
-	byte xx;
 	
+	// each column is drawn once, at its full height, so XOR mode works
 	while(x >= y)
 	{
-		for (xx=x0-x; xx<=x0+x; ++xx)
-		{
-			setPixel(xx, y0+y, val);
-			if (y <= y0)
-				setPixel(xx, y0-y, val);
-		}
-		for (xx=x0-y; xx<=x0+y; ++xx)
-		{
-			setPixel(xx, y0+x, val);
-			if (x <= y0)
-				setPixel(xx, y0-x, val);
-		}
+		circleColumns(x0, y0, y, x, val);
 
 		++y;
 		err += 1 + 2*y;
 		if(2*(err-x) + 1 > 0)
 		{
+			// column x is finished - its tallest span was the last y
+			if (x >= y)
+				circleColumns(x0, y0, x, y - 1, val);
 			--x;
 			err += 1 - 2*x;
 		}
@@ -898,15 +1779,44 @@ void I2C_graphical_LCD_display::fillCircle (const byte x0,		// center point x
 }
 //  filledCircle
 
-void I2C_graphical_LCD_display::setFont (const void * fontMap,
+//	Draw the columns x0 +/- dx from y0 - dy to y0 + dy
+void KS0108_display::circleColumns (const byte x0,
+											   const byte y0,
+											   const byte dx,
+											   const byte dy,
+											   const byte val)
+{
+	if (y0 > lastY () && y0 - dy > lastY ())
+		return;		// all below the screen
+
+	const byte top = dy <= y0 ? y0 - dy : 0;
+	const byte bottom = y0 + dy > lastY () ? lastY () : y0 + dy;
+
+	if (x0 + dx <= lastX ())
+		fillColumn(x0 + dx, top, bottom, val);
+	if (dx && dx <= x0 && x0 - dx <= lastX ())
+		fillColumn(x0 - dx, top, bottom, val);
+}  // circleColumns
+
+// the built-in 5 x 8 font (space to 0x7F), in PROGMEM
+const byte * KS0108_display::defaultFont ()
+{
+	return (const byte *) font;
+}
+
+void KS0108_display::setFont (const void * fontMap,
 										 const int width,
 										 const bool space,
 										 const byte start,
 										 const int length)
 {
+	// back to one byte per letter
+	_uCodes = NULL;
+	_utf8Left = 0;
+
 	if (fontMap == NULL)
 	{
-		_fMap = (byte *)font;
+		_fMap = defaultFont ();
 		_fWidth = 5;
 		_fSpace = true;
 		_fStart = 0x20;
@@ -920,4 +1830,708 @@ void I2C_graphical_LCD_display::setFont (const void * fontMap,
 		_fStart = start;
 		_fLength = length;
 	}
-}
\ No newline at end of file
+
+#ifdef LCD_GLYPH_CACHE
+	// forget the letters of the old font
+	for (byte i = 0; i < LCD_GLYPH_CACHE; i++)
+		_glyphs [i].used = 0;
+	_glyphTick = 0;
+#endif
+}
+
+// a Unicode font: count letters of width bytes each (glyphs), for the code points
+// in codes (ascending) - both in PROGMEM; the last letter is drawn for any code not there
+// string() and print() then take UTF-8
+void KS0108_display::setUnicodeFont (const uint16_t * codes,
+												const void * glyphs,
+												const unsigned int count,
+												const int width,
+												const bool space)
+{
+	setFont (glyphs, width, space, 0, count);
+	_uCodes = codes;
+}
+
+#ifdef LCD_ROTATION
+
+// what setOrientation() works out, in _orient
+#define ORIENT_SWAP   1   // logical x is physical y, and vice-versa
+#define ORIENT_FLIPX  2   // then physical x runs right to left
+#define ORIENT_FLIPY  4   // and physical y runs bottom to top
+
+// each byte with its bits in reverse order - turns a column of 8 pixels upside-down
+static const byte bitReverse [256] PROGMEM = {
+  0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
+  0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8,
+  0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4, 0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4,
+  0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC, 0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC,
+  0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2, 0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2,
+  0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA, 0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA,
+  0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6, 0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6,
+  0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE, 0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE,
+  0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1, 0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1,
+  0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9, 0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9,
+  0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5, 0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5,
+  0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED, 0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD,
+  0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3, 0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3,
+  0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB, 0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB,
+  0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7, 0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7,
+  0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
+};
+
+// set the orientation we draw in: rotation 0 to 3 is 0, 90, 180 or 270 degrees clockwise,
+// and mirrorX / mirrorY then flip the picture left to right / top to bottom
+// width () and height () give the size of the screen as it is now drawn
+void KS0108_display::setOrientation (const byte rotation,
+                                     const boolean mirrorX,
+                                     const boolean mirrorY)
+{
+  static const byte rotations [4] = { 0,
+                                      ORIENT_SWAP | ORIENT_FLIPX,
+                                      ORIENT_FLIPX | ORIENT_FLIPY,
+                                      ORIENT_SWAP | ORIENT_FLIPY };
+
+  _orient = rotations [rotation & 3];
+
+  // mirroring happens before rotating, so when x and y are swapped, so are the flips
+  if (mirrorX)
+    _orient ^= (_orient & ORIENT_SWAP) ? ORIENT_FLIPY : ORIENT_FLIPX;
+  if (mirrorY)
+    _orient ^= (_orient & ORIENT_SWAP) ? ORIENT_FLIPX : ORIENT_FLIPY;
+
+  gotoxy (0, 0);
+}  // end of KS0108_display::setOrientation
+
+// where physical column x, page (0 to LCD_HEIGHT / 8 - 1) lives in the cache
+int KS0108_display::cacheIndex (const byte x, const byte page) const
+{
+  const byte chip = (page >> 3) * LCD_CHIPS_ACROSS + (x >> 6);
+  return (chip << 9) + ((x & 63) << 3) + (page & 7);
+}  // end of KS0108_display::cacheIndex
+
+// send count bytes from the cache to the LCD, starting at physical column x, page
+// (all on one chip), or with ASYNC_FLUSH just note that they need sending
+void KS0108_display::sendCache (const byte x, const byte page, const byte count)
+{
+  const byte chip = (page >> 3) * LCD_CHIPS_ACROSS + (x >> 6);
+
+#ifdef ASYNC_FLUSH
+  markDirty ((chip << 3) | (page & 7), x & 63, (x & 63) + count - 1);
+#else
+  // the LCD only counts upwards, so we have to say where every run starts
+  const byte chipSelect = lcdChipSelect [chip];
+  _transport->writeCommand (chipSelect, LCD_SET_PAGE | (page & 7));
+  _transport->writeCommand (chipSelect, LCD_SET_ADD  | (x & 63));
+  _transport->writeDataRun (chipSelect, &_cache [cacheIndex (x, page)], count, 8);
+#endif
+}  // end of KS0108_display::sendCache
+
+// write a byte (8 pixels down from the logical cursor) when rotated or mirrored
+// the cache holds the screen as the LCD sees it, so everything else (reading back,
+// flushing) works as normal
+//  - not rotated: a mirrored byte has its column moved, and is turned upside down
+//    through bitReverse if y is flipped
+//  - rotated 90 or 270: the 8 pixels go across the LCD instead of down, so are one
+//    bit in each of 8 neighbouring bytes - which are then sent as a single run
+//    (drawing 8 bytes along does a whole 8x8 block, and ASYNC_FLUSH sends it once)
+void KS0108_display::writeRotated (const byte data)
+{
+  const byte y = _rotY & ~7;   // top of the byte
+
+  if (!(_orient & ORIENT_SWAP))
+    {
+    const byte x = (_orient & ORIENT_FLIPX) ? LCD_WIDTH - 1 - _rotX : _rotX;
+    byte page = y >> 3;
+    byte b = data;
+    if (_orient & ORIENT_FLIPY)
+      {
+      page = (LCD_HEIGHT / 8) - 1 - page;
+      b = pgm_read_byte (&bitReverse [b]);
+      }
+    _cache [cacheIndex (x, page)] = b;
+    sendCache (x, page, 1);
+    }
+  else
+    {
+    // logical x picks the LCD row, logical y the LCD columns
+    const byte row = (_orient & ORIENT_FLIPY) ? LCD_HEIGHT - 1 - _rotX : _rotX;
+    const byte page = row >> 3;
+    const byte mask = 1 << (row & 7);
+
+    // left-most of the 8 columns (LCD_WIDTH is a multiple of 8, so they are all on one chip)
+    const byte x = (_orient & ORIENT_FLIPX) ? LCD_WIDTH - 8 - y : y;
+    const int first = cacheIndex (x, page);
+
+    for (byte i = 0; i < 8; i++)
+      {
+      // logical bit i lands in column y + i, which is x + 7 - i if x is flipped
+      const byte bit = (_orient & ORIENT_FLIPX) ? (data >> (7 - i)) & 1 : (data >> i) & 1;
+      if (bit)
+        _cache [first + (i << 3)] |= mask;
+      else
+        _cache [first + (i << 3)] &= ~mask;
+      }
+    sendCache (x, page, 8);
+    }
+
+  // move the logical cursor along, wrapping at the end of the line
+  if (++_rotX >= width ())
+    gotoxy (0, _rotY + 8);
+}  // end of KS0108_display::writeRotated
+
+// read the byte at the logical cursor, when rotated or mirrored (the reverse of writeRotated)
+byte KS0108_display::readRotated () const
+{
+  const byte y = _rotY & ~7;
+
+  if (!(_orient & ORIENT_SWAP))
+    {
+    const byte x = (_orient & ORIENT_FLIPX) ? LCD_WIDTH - 1 - _rotX : _rotX;
+    if (_orient & ORIENT_FLIPY)
+      return pgm_read_byte (&bitReverse [_cache [cacheIndex (x, (LCD_HEIGHT / 8) - 1 - (y >> 3))]]);
+    return _cache [cacheIndex (x, y >> 3)];
+    }
+
+  const byte row = (_orient & ORIENT_FLIPY) ? LCD_HEIGHT - 1 - _rotX : _rotX;
+  const byte mask = 1 << (row & 7);
+  const byte x = (_orient & ORIENT_FLIPX) ? LCD_WIDTH - 8 - y : y;
+  const int first = cacheIndex (x, row >> 3);
+  byte data = 0;
+
+  for (byte i = 0; i < 8; i++)
+    if (_cache [first + (i << 3)] & mask)
+      data |= (_orient & ORIENT_FLIPX) ? 0x80 >> i : 1 << i;
+
+  return data;
+}  // end of KS0108_display::readRotated
+
+#endif  // LCD_ROTATION
+
+#ifdef ASYNC_FLUSH
+
+// note that columns lo to hi of row (chip * 8 + page) need sending
+// with ASYNC_FLUSH_TIMER2 the interrupt may take the row's run (setting lo to 0xFF and hi to 0)
+// between our reading and writing them, which could leave just hi set - and that reads as
+// nothing to send, so the change would never go - so interrupts are held off meanwhile
+void KS0108_display::markDirty (const byte row, const byte lo, const byte hi)
+{
+#if defined(ASYNC_FLUSH_TIMER2)
+  const byte oldSREG = SREG;
+  cli ();
+#endif
+
+  if (lo < _dirtyLo [row])
+    _dirtyLo [row] = lo;
+  if (hi > _dirtyHi [row])
+    _dirtyHi [row] = hi;
+
+#if defined(ASYNC_FLUSH_TIMER2)
+  SREG = oldSREG;
+#endif
+}  // end of KS0108_display::markDirty
+
+#if defined(ASYNC_FLUSH_TIMER2)
+// data bytes sent on each Timer2 interrupt (10000 interrupts a second) - with the two commands
+// that start a run, this is all the bus traffic one interrupt does, so keep it small
+#define ASYNC_FLUSH_TICK_BYTES 1
+
+static KS0108_display * flushInstance;
+
+ISR (TIMER2_COMPA_vect)
+{
+  if (flushInstance)
+    {
+    flushInstance->flushTick (ASYNC_FLUSH_TICK_BYTES);
+#ifdef LCD_GRAYSCALE
+    flushInstance->grayTick ();
+#endif
+    }
+}
+
+// CTC mode, prescaler 32, compare match every 50 counts: 10 kHz at 16 MHz
+static void startTimer2 (KS0108_display * instance)
+{
+  flushInstance = instance;
+  TCCR2A = bit (WGM21);
+  TCCR2B = bit (CS21) | bit (CS20);
+  OCR2A  = 49;
+  TIMSK2 |= bit (OCIE2A);
+}
+#endif
+
+// start sending everything changed since the last flush, in the background
+// call flushTick() regularly (eg. from loop or a timer interrupt) to make progress,
+// unless ASYNC_FLUSH_TIMER2 is defined, in which case Timer2 does it for you
+// done (if supplied) is called once nothing is left to send
+void KS0108_display::flushAsync (void (*done) ())
+{
+  _flushDone = done;
+  _flushBusy = true;
+
+#if defined(ASYNC_FLUSH_TIMER2)
+  startTimer2 (this);
+#endif
+}  // end of KS0108_display::flushAsync
+
+// send up to maxBytes changed bytes to the LCD
+// returns true if there is more to do, false once the flush has finished
+// (drawing done while a flush is in progress is picked up by the same flush)
+boolean KS0108_display::flushTick (byte maxBytes)
+{
+  if (!_flushBusy)
+    return false;
+
+  while (maxBytes)
+    {
+    // finished the current run? look for the next row with changes
+    if (_flushX > _flushEnd && !startRun (false))
+      {
+      // nothing left - all done
+      _flushBusy = false;
+#if defined(ASYNC_FLUSH_TIMER2)
+#ifdef LCD_GRAYSCALE
+      // (the grayscale planes may still need Timer2)
+      if (!_grayOn && _grayPhase == GRAY_SHOW_HI)
+#endif
+      TIMSK2 &= ~bit (OCIE2A);
+#endif
+      if (_flushDone)
+        _flushDone ();
+      return false;
+      }
+
+    maxBytes -= sendRun (maxBytes);
+    }
+
+  return true;
+}  // end of KS0108_display::flushTick
+
+// take the changes on the next row that has any as the run to send, and position the LCD
+// at its start - the next row round from the last one, or (shortest true) the row with
+// the fewest changed columns
+// returns false if nothing has changed
+boolean KS0108_display::startRun (const boolean shortest)
+{
+  byte found = 0xFF;
+  byte fewest = 0xFF;
+  for (byte i = 0; i < LCD_CHIPS * 8; i++)
+    {
+    const byte row = (_flushRow + i) % (LCD_CHIPS * 8);
+    if (_dirtyLo [row] > _dirtyHi [row])
+      continue;
+    if (_dirtyHi [row] - _dirtyLo [row] < fewest)
+      {
+      found = row;
+      fewest = _dirtyHi [row] - _dirtyLo [row];
+      }
+    if (!shortest || fewest == 0)
+      break;    // (can't do better than one column)
+    }
+
+  if (found == 0xFF)
+    return false;
+
+  // take this run, new changes to the row start a fresh one
+  _flushRow = found;
+  _flushX = _dirtyLo [_flushRow];
+  _flushEnd = _dirtyHi [_flushRow];
+  _dirtyLo [_flushRow] = 0xFF;
+  _dirtyHi [_flushRow] = 0;
+
+  // position the LCD at the start of the run
+  // (straight to the transport, so the drawing code's chip select is left alone)
+  _transport->writeCommand (lcdChipSelect [_flushRow >> 3], LCD_SET_PAGE | (_flushRow & 7));
+  _transport->writeCommand (lcdChipSelect [_flushRow >> 3], LCD_SET_ADD  | _flushX);
+  return true;
+}  // end of KS0108_display::startRun
+
+// send as much of the current run as we are allowed to in one go
+// (cache holds 8 pages per column, 512 bytes per chip)
+byte KS0108_display::sendRun (const byte maxBytes)
+{
+  byte n = _flushEnd - _flushX + 1;
+  if (n > maxBytes)
+    n = maxBytes;
+  _transport->writeDataRun (lcdChipSelect [_flushRow >> 3],
+                            &_cache [((_flushRow >> 3) << 9) + (_flushX << 3) + (_flushRow & 7)],
+                            n, 8);
+  _flushX += n;
+  return n;
+}  // end of KS0108_display::sendRun
+
+// send up to maxBytes changed bytes, rows with the fewest changes first, carrying on
+// with the run the last call was in the middle of
+// unlike flushTick this needs no flushAsync() first, and calls no callback
+// returns the number of bytes still to send
+unsigned int KS0108_display::flushSome (unsigned int maxBytes)
+{
+#if defined(ASYNC_FLUSH_TIMER2)
+  if (_flushBusy)
+    return pending ();   // Timer2 is doing the work
+#endif
+
+  while (maxBytes)
+    {
+    if (_flushX > _flushEnd && !startRun (true))
+      break;    // all sent
+    maxBytes -= sendRun (maxBytes > 255 ? 255 : maxBytes);
+    }
+
+  return pending ();
+}  // end of KS0108_display::flushSome
+
+// bytes sent by flushFor between looking at the time
+#define FLUSH_FOR_BYTES 8
+
+// send changed bytes (as flushSome) for up to maxMicros microseconds
+// a few bytes are sent at a time, stopping when another lot would take us past maxMicros
+// (going by how long the last lot took) - at least one lot is always sent
+// returns the number of bytes still to send
+unsigned int KS0108_display::flushFor (const unsigned long maxMicros)
+{
+  const unsigned long start = micros ();
+  unsigned long took;     // by the last lot
+  unsigned int left;
+
+  do
+    {
+    const unsigned long before = micros ();
+    left = flushSome (FLUSH_FOR_BYTES);
+    took = micros () - before;
+    } while (left && micros () - start + took <= maxMicros);
+
+  return left;
+}  // end of KS0108_display::flushFor
+
+// how many bytes are waiting to be sent: the changed columns of each row, and what is
+// left of the run being sent
+unsigned int KS0108_display::pending () const
+{
+  unsigned int count = 0;
+  for (byte row = 0; row < LCD_CHIPS * 8; row++)
+    if (_dirtyLo [row] <= _dirtyHi [row])
+      count += _dirtyHi [row] - _dirtyLo [row] + 1;
+  if (_flushX <= _flushEnd)
+    count += _flushEnd - _flushX + 1;
+  return count;
+}  // end of KS0108_display::pending
+
+// send all changes to the LCD and wait until they are done
+void KS0108_display::flush ()
+{
+  if (!_flushBusy)
+    flushAsync (_flushDone);
+
+#if defined(ASYNC_FLUSH_TIMER2)
+  while (_flushBusy)
+    { }   // Timer2 is doing the work
+#else
+  while (flushTick (255))
+    { }
+#endif
+}  // end of KS0108_display::flush
+
+#endif  // ASYNC_FLUSH
+
+#if defined(LCD_VERIFY) || defined(LCD_GRAYSCALE)
+
+// after verifyTick or grayTick has set the LCD's address for its own use on the chips in
+// chipSelects, put it back for whoever carries on without a gotoxy: the run flushSome or
+// flushTick is part way through (ASYNC_FLUSH), or else the drawing code
+void KS0108_display::restoreAddress (const byte chipSelects)
+{
+#ifdef ASYNC_FLUSH
+  const byte chipSelect = lcdChipSelect [_flushRow >> 3];
+  if (_flushX <= _flushEnd && (chipSelects & chipSelect))
+    {
+    _transport->writeCommand (chipSelect, LCD_SET_PAGE | (_flushRow & 7));
+    _transport->writeCommand (chipSelect, LCD_SET_ADD  | _flushX);
+    }
+#else
+  if (chipSelects & _chipSelect)
+    {
+    _transport->writeCommand (_chipSelect, LCD_SET_PAGE | ((_lcdy >> 3) & 7));
+    _transport->writeCommand (_chipSelect, LCD_SET_ADD  | _lcdx);
+    }
+#endif
+}  // end of KS0108_display::restoreAddress
+
+#endif  // LCD_VERIFY || LCD_GRAYSCALE
+
+#ifdef LCD_GRAYSCALE
+
+// set the pixel at x,y to a gray level: 0 (white) to 3 (black)
+// the first plane (the cache) gets bit 1 of the level, the second plane bit 0
+void KS0108_display::setGrayPixel (const byte x,
+                                   const byte y,
+                                   const byte level)
+{
+  if (x >= LCD_WIDTH || y >= LCD_HEIGHT)
+    return;
+
+  const byte bit = 1 << (y & 7);
+
+  gotoxy (x, y);
+  const int offset = _cacheOffset;
+  const byte lo = _plane [offset];
+  byte c = readData ();
+
+  if (level & 2)
+    c |= bit;
+  else
+    c &= ~bit;
+  putData (c);
+
+  _plane [offset] = (level & 1) ? lo | bit : lo & ~bit;
+
+  // grayTick() needs to send this column from now on (it works out later if it doesn't)
+  const byte row = ((offset >> 9) << 3) | (offset & 7);
+  const byte column = (offset >> 3) & 63;
+  if (column < _grayFirst [row])
+    _grayFirst [row] = column;
+  if (column > _grayLast [row])
+    _grayLast [row] = column;
+}  // end of KS0108_display::setGrayPixel
+
+// the gray level (0 to 3) of the pixel at x,y
+byte KS0108_display::getGrayPixel (const byte x,
+                                   const byte y)
+{
+  if (x >= LCD_WIDTH || y >= LCD_HEIGHT)
+    return 0;
+
+  gotoxy (x, y);
+  return (((_cache [_cacheOffset] >> (y & 7)) & 1) << 1) | ((_plane [_cacheOffset] >> (y & 7)) & 1);
+}  // end of KS0108_display::getGrayPixel
+
+// fill the rectangle x1,y1,x2,y2 (inclusive) with a gray level
+void KS0108_display::fillGrayRect (const byte x1,
+                                   const byte y1,
+                                   byte x2,
+                                   byte y2,
+                                   const byte level)
+{
+  // stop at the edge of the screen
+  if (x2 > lastX ())
+    x2 = lastX ();
+  if (y2 > lastY ())
+    y2 = lastY ();
+
+  for (byte y = y1; y <= y2; y++)
+    for (byte x = x1; x <= x2; x++)
+      setGrayPixel (x, y, level);
+}  // end of KS0108_display::fillGrayRect
+
+// start or stop showing gray levels
+// frameMicros: how long a frame lasts - the first plane is shown for two, the second for one
+//  (too long flickers, too short and the LCD pixels don't have time to settle)
+// budget: the most bytes each grayTick() sends, so it doesn't hold up anything else for long
+// stopping puts the first plane back on the screen over the next few grayTick()s
+void KS0108_display::setGrayscale (const boolean on,
+                                   const unsigned int frameMicros,
+                                   const byte budget)
+{
+  _grayFrame = frameMicros;
+  _grayBudget = budget ? budget : 1;
+  if (on && !_grayOn)
+    _grayTime = micros ();
+  _grayOn = on;
+
+#if defined(ASYNC_FLUSH_TIMER2)
+  if (on)
+    startTimer2 (this);
+#endif
+}  // end of KS0108_display::setGrayscale
+
+// show the planes in turn: call this often (eg. from loop), unless ASYNC_FLUSH_TIMER2
+// has Timer2 doing it
+// only the columns where the planes differ are sent when changing plane, and
+// those only a budget's worth at a time
+// returns false once stopped
+boolean KS0108_display::grayTick ()
+{
+  switch (_grayPhase)
+    {
+    case GRAY_SHOW_HI:
+      if (!_grayOn)
+        {
+#if defined(ASYNC_FLUSH_TIMER2)
+        if (!_flushBusy)
+          TIMSK2 &= ~bit (OCIE2A);
+#endif
+        return false;
+        }
+      if (micros () - _grayTime < 2UL * _grayFrame)
+        return true;
+      _grayPhase = GRAY_SEND_LO;
+      _grayRow = 0;
+      _grayX = 1;
+      _grayEnd = 0;
+      break;
+
+    case GRAY_SHOW_LO:
+      // (when stopping, put the first plane back straight away)
+      if (_grayOn && micros () - _grayTime < _grayFrame)
+        return true;
+      _grayPhase = GRAY_SEND_HI;
+      _grayRow = 0;
+      _grayX = 1;
+      _grayEnd = 0;
+      break;
+    }
+
+  const byte * plane = (_grayPhase == GRAY_SEND_LO) ? _plane : _cache;
+  byte budget = _grayBudget;
+  byte used = 0;    // chip selects we sent to
+
+  // carrying on with a row from the last call? drawing, or a flush, may have moved the address since
+  if (_grayX <= _grayEnd)
+    {
+    _transport->writeCommand (lcdChipSelect [_grayRow >> 3], LCD_SET_PAGE | (_grayRow & 7));
+    _transport->writeCommand (lcdChipSelect [_grayRow >> 3], LCD_SET_ADD  | _grayX);
+    }
+
+  while (budget)
+    {
+    // finished a row? find the next one where the planes differ
+    if (_grayX > _grayEnd)
+      {
+      byte first = 0, last = 0;
+      for ( ; _grayRow < LCD_CHIPS * 8; _grayRow++)
+        {
+        first = _grayFirst [_grayRow];
+        last = _grayLast [_grayRow];
+        if (first > last)
+          continue;
+
+        if (_grayPhase == GRAY_SEND_LO)
+          {
+          // trim the ends where the planes turn out to be the same (eg. drawn over since)
+          const int base = ((_grayRow >> 3) << 9) + (_grayRow & 7);
+          while (first <= last && _cache [base + (first << 3)] == _plane [base + (first << 3)])
+            first++;
+          if (first > last)
+            {
+            _grayFirst [_grayRow] = 0xFF;
+            _grayLast [_grayRow] = 0;
+            continue;
+            }
+          while (_cache [base + (last << 3)] == _plane [base + (last << 3)])
+            last--;
+          _grayFirst [_grayRow] = first;
+          _grayLast [_grayRow] = last;
+          }
+        break;
+        }
+
+      if (_grayRow >= LCD_CHIPS * 8)
+        {
+        // that plane is all on the LCD now - show it for its share of the time
+        _grayPhase = (_grayPhase == GRAY_SEND_LO) ? GRAY_SHOW_LO : GRAY_SHOW_HI;
+        _grayTime = micros ();
+        break;
+        }
+
+      _grayX = first;
+      _grayEnd = last;
+      _transport->writeCommand (lcdChipSelect [_grayRow >> 3], LCD_SET_PAGE | (_grayRow & 7));
+      _transport->writeCommand (lcdChipSelect [_grayRow >> 3], LCD_SET_ADD  | first);
+      }
+
+    // send as much of the row as the budget allows
+    byte n = _grayEnd - _grayX + 1;
+    if (n > budget)
+      n = budget;
+    _transport->writeDataRun (lcdChipSelect [_grayRow >> 3],
+                              &plane [((_grayRow >> 3) << 9) + (_grayX << 3) + (_grayRow & 7)],
+                              n, 8);
+    used |= lcdChipSelect [_grayRow >> 3];
+    _grayX += n;
+    budget -= n;
+    if (_grayX > _grayEnd)
+      _grayRow++;
+    }
+
+  restoreAddress (used);
+  return true;
+}  // end of KS0108_display::grayTick
+
+#endif  // LCD_GRAYSCALE
+
+#ifdef LCD_VERIFY
+
+// check the next line (one page of one chip) against the cache, and repaint what differs
+// reading back has to set the address for each byte (as testPattern does), so it costs
+// more than sending the line - but only the columns from the first wrong byte to the last
+// are sent again, and glitches can be counted
+// if the LCD can't be read back, the whole line is sent again instead: a 128 x 64 screen
+// is then refreshed in 16 calls, rather than 1 KB at once
+// returns true if the line was read back and found to be wrong
+boolean KS0108_display::verifyTick ()
+{
+#ifdef ASYNC_FLUSH
+  // the LCD is behind the cache until the flush is done
+  if (_flushBusy)
+    return false;
+#endif
+#ifdef LCD_GRAYSCALE
+  // the LCD is showing each plane in turn, not what is in the cache
+  if (_grayOn || _grayPhase != GRAY_SHOW_HI)
+    return false;
+#endif
+
+  const byte row = _verifyRow;
+  _verifyRow = (_verifyRow + 1) % (LCD_CHIPS * 8);
+
+#ifdef ASYNC_FLUSH
+  // changes not sent yet? the line gets sent anyway at the next flush
+  if (_dirtyLo [row] <= _dirtyHi [row] || (row == _flushRow && _flushX <= _flushEnd))
+    return false;
+#endif
+
+  const byte chipSelect = lcdChipSelect [row >> 3];
+  const byte * cached = &_cache [((row >> 3) << 9) + (row & 7)];   // 8 pages per column
+
+  // the last chip in each row may be only partly used
+  byte columns = 64;
+#if LCD_WIDTH % 64
+  if ((row >> 3) % LCD_CHIPS_ACROSS == LCD_CHIPS_ACROSS - 1)
+    columns = LCD_WIDTH % 64;
+#endif
+
+  byte first = 0, last = columns - 1;
+  boolean wrong = false;
+  _verifyChecked++;
+
+  _transport->writeCommand (chipSelect, LCD_SET_PAGE | (row & 7));
+  if (_transport->canRead ())
+    {
+    first = 0xFF;
+    for (byte x = 0; x < columns; x++)
+      {
+      _transport->writeCommand (chipSelect, LCD_SET_ADD | x);
+      if (_transport->readData (chipSelect) != cached [x << 3])
+        {
+        if (first == 0xFF)
+          first = x;
+        last = x;
+        }
+      }
+    if (first != 0xFF)
+      {
+      _verifyRepaired++;
+      wrong = true;
+      }
+    }
+
+  if (first != 0xFF)
+    {
+    _transport->writeCommand (chipSelect, LCD_SET_ADD | first);
+    _transport->writeDataRun (chipSelect, cached + (first << 3), last - first + 1, 8);
+    }
+
+  restoreAddress (chipSelect);
+  return wrong;
+}  // end of KS0108_display::verifyTick
+
+#endif  // LCD_VERIFY
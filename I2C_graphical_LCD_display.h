@@ -43,6 +43,63 @@
 																 -- These defines must appear in calling app PRIOR to including this library
 
  version 4.1 : 08 June 2020			 -- Added bit operation optimization for ESP8266																 
+ Version 4.2 : 18 October 2026   -- added ASYNC_FLUSH option: draw into the cache, then send only changed bytes
+                                 -- with flush(), or in the background with flushAsync()/flushTick()/isBusy()
+ Version 4.3 : 18 October 2026   -- SPI busy delay is now counted from the end of the previous LCD operation,
+                                 -- and only applied before operations that pulse enable, not every transaction
+                                 -- added setBusyDelay(), calibrateBusyDelay() and LCD_BUSY_POLL (busy flag polling)
+ Version 4.4 : 18 October 2026   -- added LCD_timing, passed to begin(), for I2C/SPI clocks, SPI mode, enable width and busy delay
+                                 -- added tuneBusClock() to find the fastest bus clock that reads back correctly
+                                 -- MCP23017 and MCP23S17 builds now include both Wire and SPI, which the code needs
+ Version 4.5 : 18 October 2026   -- added HC595_SPI and HC595_SPI_LATCH: 74HC595 interface driven by hardware SPI
+ Version 5.0 : 18 October 2026   -- bus code moved into transport classes (KS0108_transport.h/.cpp): KS0108_2wire,
+                                 -- KS0108_MCP23017, KS0108_MCP23S17 - pass one to the constructor to choose the bus at run time
+                                 -- background flush sends each run through the transport in one go
+ Version 5.1 : 18 October 2026   -- added LCD_WIDTH and LCD_HEIGHT for panels of up to 4 chips (192x64, 240x64, 128x128)
+                                 -- CS3/CS4 on GPA1/GPA0 of the MCP23x17 and IC2 QF/QG of the 74HC595 board
+ Version 5.2 : 18 October 2026   -- added LCD_ROTATION and setOrientation(): 0/90/180/270 degree rotation and X/Y mirroring,
+                                 -- with width() and height() for the size as drawn
+                                 -- clear(), fillRect() and frameRect() stop at the edge of the screen (their default end is now 0xFF)
+ Version 5.3 : 18 October 2026   -- added LCD_GRAYSCALE: 4 gray levels from two bitplanes shown 2:1 in turn by grayTick() (or Timer2),
+                                 -- with setGrayPixel(), getGrayPixel(), fillGrayRect() and setGrayscale()
+ Version 5.4 : 18 October 2026   -- added drawGrayImage() (8-bit pictures, ordered dither on the fly) and blitRLE() (run-length encoded pictures)
+                                 -- added extras/ks0108conv.cpp to turn PGM pictures into headers for blit, blitRLE and drawGrayImage
+ Version 5.5 : 18 October 2026   -- Added setDrawMode (copy, set, clear, xor) and invertRect
+                                 -- circle, fillCircle and frameRect draw each pixel once
+                                 -- setPixel no longer garbled by setInv
+ Version 5.6 : 18 October 2026   -- Added retained-mode widgets (KS0108_widgets.h) and glyphColumn
+ Version 5.7 : 18 October 2026   -- LCD_bar can fill upwards, and only sends the part that changed
+ Version 5.8 : 18 October 2026   -- LCD_value redraws only changed letters, has fixed point and alignment
+ Version 5.9 : 18 October 2026   -- added LCD_GLYPH_CACHE: recently drawn letters kept in RAM, ready to send
+ Version 6.0 : 18 October 2026   -- added KS0108_fonts.h: LCD_font (size as template arguments) for letter() and string(),
+                                 -- and LCD_FONT_SUBSET to build a font of just the letters used, at compile time
+ Version 6.1 : 18 October 2026   -- added setUnicodeFont(): fonts of any code points, found by binary search, with UTF-8
+                                 -- text in string() and print(); LCD_UNICODE_FROM_CP437 builds one from cp437_font
+ Version 6.2 : 18 October 2026   -- added fillTriangle() and fillPolygon(): filled a column at a time, each byte of
+                                 -- the screen read and written once
+ Version 6.3 : 18 October 2026   -- added fill patterns (setPattern, setUserPattern) for fillRect, fillCircle and polygons;
+                                 -- fillRect and fillCircle now change each byte once, down each column
+ Version 6.4 : 18 October 2026   -- added copyRect(): copies (or moves, if they overlap) part of the screen to another place
+ Version 6.5 : 18 October 2026   -- added scrollRegion(): scrolls part of the screen sideways, bringing in new columns,
+                                 -- each line sent in one run
+ Version 6.6 : 18 October 2026   -- added saveRegion() and restoreRegion(), with an optional arena (LCD_REGION_ARENA), to put
+                                 -- back what was under popups and menus
+ Version 6.7 : 18 October 2026   -- begin() waits for the LCD's reset flag (MCP23x17) and blanks the LCD in runs, a line of each chip at a time
+ Version 6.8 : 18 October 2026   -- LCD_VERIFY: verifyTick() checks the screen a line at a time against the cache and repaints what differs
+                                 -- busErrors() counts I2C transfers the MCP23017 didn't acknowledge
+ Version 6.9 : 18 October 2026   -- KS0108_displaylist.h: record drawing calls (or keep them in PROGMEM) and draw them a line at a time,
+                                 -- sending each byte touched once
+ Version 7.0 : 18 October 2026   -- Added flushSome(), flushFor() and pending() (ASYNC_FLUSH): send changes a slice at a time from
+                                 -- loop(), shortest rows first
+ Version 7.1 : 18 October 2026   -- KS0108_display is the display without a built-in transport, for use with your own;
+                                 -- I2C_graphical_LCD_display builds in the 2-wire / MCP23x17 one (no longer takes a transport)
+ Version 7.2 : 18 October 2026   -- verifyTick() puts the LCD's address back for a run flushSome() is part way through
+ Version 7.3 : 18 October 2026   -- LCD_BUSY_POLL also polls between the bytes of a run (MCP23S17), instead of waiting out the busy delay
+ Version 7.4 : 18 October 2026   -- grayTick() puts the LCD's address back for the drawing code or a part-sent flush run, and sets its own
+                                 -- again when carrying on with a row
+ Version 7.5 : 18 October 2026   -- drawGrayImage() no longer inverts or XORs the pixels above and below a picture that ends part way down a line
+ Version 7.6 : 18 October 2026   -- LCD_bar and LCD_sparkline scale in long, so a range wider than 32767 no longer overflows on AVR
+ Version 7.7 : 18 October 2026   -- LCD_value's width is worked out from the number of digits it can actually show
 
   * These changes required hardware changes to pin configurations
 
@@ -76,20 +133,82 @@
 // Define this to cache display content instead of reading back from display
 //#define WRITETHROUGH_CACHE
 
+// Define this to poll the LCD busy flag (MCP23S17 only) rather than always waiting
+// for the busy delay before each operation - runs of data (flush, clear, display lists)
+// are then sent a byte per transaction, so the flag can be polled between them
+//#define LCD_BUSY_POLL
+
+// Define one of these to drive the 74HC595 board from the
+// hardware SPI port instead of bit-banging it - much faster, but CLK and DATA must then be
+// wired to SCK and MOSI:
+//   HC595_SPI       - the standard 2-wire board, diode latch and all
+//   HC595_SPI_LATCH - 3-wire: LATCH (pin 12 of both 74HC595s) driven from its own pin,
+//                     instead of through D1/R1 (see latchPin in the constructor)
+//#define HC595_SPI
+//#define HC595_SPI_LATCH
+
+// Panel size in pixels, if not the usual 128 x 64. Each KS0108 chip drives 64 x 64
+// pixels, and up to 4 chips are supported (see LCD_CS1 to LCD_CS4), for example:
+//   192 x 64 (3 chips), 240 x 64 (4 chips), 128 x 128 (4 chips, 2 rows of 2)
+// Chips are numbered left to right, then top to bottom. Only the last chip may be partly used.
+//#define LCD_WIDTH  192
+//#define LCD_HEIGHT 64
+
+// Define this for setOrientation(): rotate the display by 90, 180 or 270 degrees, and/or mirror it
+// (uses the cache; with ASYNC_FLUSH as well, rotated drawing sends no more to the LCD than normal)
+//#define LCD_ROTATION
+
+// Define this for 4-level grayscale (setGrayPixel() and friends). Two bitplanes are shown in
+// turn - the first for two frames, the second for one - by calling grayTick() often, or by
+// Timer2 with ASYNC_FLUSH_TIMER2. Needs another 512 bytes of RAM per chip (so not an Uno).
+//#define LCD_GRAYSCALE
+
+// Define this as a number of letters to keep the most recently drawn letters in RAM, ready
+// to send (already inverted if need be), rather than reading each column from PROGMEM again.
+// Worth it where flash reads are slow (ESP8266, SAMD). Each letter takes LCD_GLYPH_CACHE_WIDTH + 5
+// bytes; fonts wider than that (counting the gap) are drawn straight from PROGMEM as before.
+//#define LCD_GLYPH_CACHE 8
+//#define LCD_GLYPH_CACHE_WIDTH 8
+
+// Define this as a number of bytes for saveRegion() to keep what is under popups and menus in,
+// when it isn't given a buffer of its own - a byte for each column of each 8-pixel line saved
+//#define LCD_REGION_ARENA 256
+
+// Define this for verifyTick(): check the screen a line of one chip at a time against the
+// cache, and repaint just the lines that have gone wrong (eg. through noise on a long cable).
+// The MCP23017 / MCP23S17 read each line back to compare it; the 2-wire interface can't read,
+// so there each line is simply sent again in turn. Uses the cache.
+//#define LCD_VERIFY
+
+// Define this to draw into the cache only and send changed bytes to the display
+// later, using flush() (blocking) or flushAsync() / flushTick() (in the background)
+//#define ASYNC_FLUSH
+
+// Define this as well to have Timer2 call flushTick() while a flushAsync() is running
+// (AVR only, and not with MCP23017 because Wire needs interrupts to be enabled)
+// Timer2 is then taken over, so tone() and PWM on pins 3 and 11 (Uno) no longer work
+//#define ASYNC_FLUSH_TIMER2
+
 #if defined(ARDUINO) && ARDUINO >= 100
   #include "Arduino.h"
 #else
   #include <WProgram.h>
 #endif
 
+#if defined(MCP23017) || defined(MCP23S17)
+#define MCP23x17
+#endif
+
+#if defined(HC595_SPI) || defined(HC595_SPI_LATCH)
+#define HC595_HWSPI
+#endif
+
+// only include the libraries the interfaces in use need
 #if defined(MCP23017)
 #include <Wire.h>
-#elif defined(MCP23S17)
-#include <SPI.h>
 #endif
-
-#if defined(MCP23017) || defined(MCP23S17)
-#define MCP23x17
+#if defined(MCP23S17) || defined(HC595_HWSPI)
+#include <SPI.h>
 #endif
 
 // WRITETHROUGH_CACHE must be defined if 2-wire interface is used
@@ -97,11 +216,67 @@
 #define WRITETHROUGH_CACHE
 #endif
 
+// ASYNC_FLUSH sends from the cache, so it needs it too
+#if defined(ASYNC_FLUSH) && !defined(WRITETHROUGH_CACHE)
+#define WRITETHROUGH_CACHE
+#endif
+
+// so does LCD_ROTATION, to turn logical bytes into physical ones
+#if defined(LCD_ROTATION) && !defined(WRITETHROUGH_CACHE)
+#define WRITETHROUGH_CACHE
+#endif
+
+// and LCD_GRAYSCALE, where the cache is the first bitplane
+#if defined(LCD_GRAYSCALE) && !defined(WRITETHROUGH_CACHE)
+#define WRITETHROUGH_CACHE
+#endif
+
+// LCD_VERIFY compares the LCD with the cache
+#if defined(LCD_VERIFY) && !defined(WRITETHROUGH_CACHE)
+#define WRITETHROUGH_CACHE
+#endif
+
+#if defined(LCD_GRAYSCALE) && defined(LCD_ROTATION)
+#error LCD_GRAYSCALE and LCD_ROTATION cannot be used together
+#endif
+
+#if defined(LCD_GLYPH_CACHE) && !defined(LCD_GLYPH_CACHE_WIDTH)
+#define LCD_GLYPH_CACHE_WIDTH 8
+#endif
+
+#if !defined(LCD_WIDTH)
+#define LCD_WIDTH 128
+#endif
+#if !defined(LCD_HEIGHT)
+#define LCD_HEIGHT 64
+#endif
+
+#define LCD_CHIPS_ACROSS ((LCD_WIDTH + 63) / 64)    // chips in each row of the panel
+#define LCD_CHIP_ROWS    (LCD_HEIGHT / 64)          // rows of chips
+#define LCD_CHIPS        (LCD_CHIPS_ACROSS * LCD_CHIP_ROWS)
+
+#if LCD_WIDTH > 255 || LCD_HEIGHT > 128 || (LCD_HEIGHT % 64) || LCD_CHIPS > 4 || (LCD_CHIP_ROWS > 1 && (LCD_WIDTH % 64))
+#error LCD_WIDTH and LCD_HEIGHT must make up to 4 chips of 64 x 64 pixels (only the last chip may be partly used)
+#endif
+
+#if defined(LCD_ROTATION) && (LCD_WIDTH % 8)
+#error LCD_ROTATION needs LCD_WIDTH to be a multiple of 8
+#endif
+
+#if defined(ASYNC_FLUSH_TIMER2) && (!defined(ASYNC_FLUSH) || !defined(__AVR__) || defined(MCP23017))
+#error ASYNC_FLUSH_TIMER2 needs ASYNC_FLUSH on an AVR, using the 2-wire or MCP23S17 interface
+#endif
+
 #if defined(__AVR__)
 #include <avr/pgmspace.h>
-#elif !defined(pgm_read_byte)
+#else
+#if !defined(pgm_read_byte)
 #define pgm_read_byte(addr) (*(const unsigned char *)(addr))
 #endif
+#if !defined(pgm_read_word)
+#define pgm_read_word(addr) (*(const unsigned short *)(addr))
+#endif
+#endif
 
 // MCP23017/MCP23S17 registers (everything except direction defaults to 0)
 
@@ -146,6 +321,10 @@
  17      25 (GPA4)     ~RST   1 = not reset, 0 = reset
  16      24 (GPA3)     CS2    Chip select for IC2 (1 = active)  (see LCD_CS2)
  15      23 (GPA2)     CS1    Chip select for IC1 (1 = active)  (see LCD_CS1)
+  *      22 (GPA1)     CS3    Chip select for IC3 - panels with 3 or 4 chips  (see LCD_CS3)
+  *      21 (GPA0)     CS4    Chip select for IC4 - panels with 4 chips       (see LCD_CS4)
+
+ * The CS3/CS4 pin number varies between panels - check the data sheet
  
  --- Port "B" - data lines
  
@@ -184,8 +363,8 @@
  18   (~RST)           Tie to +5V via 10K resistor (reset signal)
  19   (INTA)           Interrupt for port A (not used)
  20   (INTB)           Interrupt for port B (not used)
- 21   (GPA0)           Not used
- 22   (GPA1)           Not used
+ 21   (GPA0)           Not used (CS4 on 4-chip panels)
+ 22   (GPA1)           Not used (CS3 on 3 or 4-chip panels)
  23   (GPA2)           Not used
  
  IMPORTANT: For reliable operation:
@@ -222,8 +401,8 @@ IC2
   2   (QC)			   D0	   	 LCD pin 7
   3   (QD)			   DI	   	 LCD pin 4
   4   (QE)         Enable	 LCD pin 6
-  5   (QF)               	 No connection
-  6   (QG)                 No connection
+  5   (QF)         CS3     LCD CS3 (3 or 4-chip panels only, otherwise no connection)
+  6   (QG)         CS4     LCD CS4 (4-chip panels only, otherwise no connection)
   7   (QH)                 No connection
   8   (VSS)        GND     Ground for IC2
   9   (QH*)        Control Cathode of D1
@@ -258,6 +437,13 @@ LCD Power On Reset circuit:
 
 For reliable operation, place a 0.1 ufd bypass capacitor across power pins (8 and 16) of each 74HC595
 
+---- Hardware SPI (HC595_SPI / HC595_SPI_LATCH) ----
+
+HC595_SPI:        CLK to the SPI SCK pin (D13 on the Uno), DATA to MOSI (D11 on the Uno).
+                  Everything else, including D1 and R1, is wired as above.
+HC595_SPI_LATCH:  As HC595_SPI, but leave out D1 and R1 and connect LATCH (pin 12 of both
+                  74HC595s) to the latchPin given to the constructor.
+
 */
 
 
@@ -265,12 +451,44 @@ For reliable operation, place a 0.1 ufd bypass capacitor across power pins (8 an
 
 #define LCD_CS1    0b00000100   // chip select 1  (pin 23)                            0x04
 #define LCD_CS2    0b00001000   // chip select 2  (pin 24)                            0x08
+#define LCD_CS3    0b00000010   // chip select 3  (pin 22)                            0x02
+#define LCD_CS4    0b00000001   // chip select 4  (pin 21)                            0x01
 #define LCD_RESET  0b00010000   // reset (pin 25)                                     0x10
 #define LCD_DATA   0b00100000   // 1xxxxxxx = data; 0xxxxxxx = instruction  (pin 26)  0x20
 #define LCD_READ   0b01000000   // x1xxxxxx = read; x0xxxxxx = write  (pin 27)        0x40
 #define LCD_ENABLE 0b10000000   // enable by toggling high/low  (pin 28)              0x80
 
 
+// SPI is so fast we need to give the LCD time to catch up.
+// This is the number of microseconds we wait. Something like 20 to 50 is probably reasonable.
+//  Increase this value if the display is either not working, or losing data.
+// This is only the default - see LCD_timing, setBusyDelay() and calibrateBusyDelay().
+
+#define LCD_BUSY_DELAY 50   // microseconds
+
+// Bus and LCD timing, passed to begin() - anything not given takes the default shown
+// The clocks are applied with Wire.setClock() and SPISettings, so work on AVR, SAMD and ESP8266
+// (not every board can reach every I2C clock - tuneBusClock() finds the fastest that works)
+
+struct LCD_timing
+{
+  unsigned long i2cClock;   // I2C clock in Hz: 100000, 400000, 1000000 or 1700000 (0 = Wire default)
+                            // (on AVR at most F_CPU / 16 - 1 MHz at 16 MHz - faster is taken as that)
+  unsigned long spiClock;   // SPI clock in Hz (the MCP23S17 is rated to 10 MHz)
+  byte spiMode;             // SPI mode, 0 to 3 (the MCP23S17 works in modes 0 and 3)
+  byte enableWidth;         // extra microseconds to hold enable high (0 = none needed)
+  byte busyDelay;           // microseconds between LCD operations (SPI only)
+
+  LCD_timing (const unsigned long i2c = 0,
+              const unsigned long spi = 4000000,
+              const byte mode = 0,
+              const byte enable = 0,
+              const byte busy = LCD_BUSY_DELAY) :
+              i2cClock (i2c), spiClock (spi), spiMode (mode), enableWidth (enable), busyDelay (busy) {}
+};
+
+#include "KS0108_transport.h"
+
 // Commands sent when LCD in "instruction" mode (LCD_DATA bit set to 0)
 
 #define LCD_ON          0x3F
@@ -279,70 +497,168 @@ For reliable operation, place a 0.1 ufd bypass capacitor across power pins (8 an
 #define LCD_SET_PAGE    0xB8   // plus Y address (0 to 7)
 #define LCD_DISP_START  0xC0   // plus X address (0 to 63) - for scrolling
 
-class I2C_graphical_LCD_display : public Print
+// Drawing modes (setDrawMode) - how what is drawn combines with what is already there
+
+#define LCD_MODE_COPY   0      // pixels become what is drawn (the default)
+#define LCD_MODE_SET    1      // only set pixels (val 1 draws black, 0 leaves alone)
+#define LCD_MODE_CLEAR  2      // only clear pixels (val 1 draws white, 0 leaves alone)
+#define LCD_MODE_XOR    3      // flip pixels (val 1 flips, 0 leaves alone) - drawing twice undoes it
+
+// scrollRegion moves right up to this many columns in one pass (it keeps them on the stack)
+#ifndef LCD_SCROLL_MAX
+#define LCD_SCROLL_MAX  16
+#endif
+
+// bytes saveRegion needs for columns x1 to x2 of the lines y1 to y2 (on the screen)
+#define LCD_REGION_SIZE(x1, y1, x2, y2) (((x2) - (x1) + 1) * (((y2) >> 3) - ((y1) >> 3) + 1))
+
+// Fill patterns (setPattern) - for fillRect, fillCircle, fillTriangle and fillPolygon
+
+#define LCD_PATTERN_SOLID         0   // every pixel (the default)
+#define LCD_PATTERN_12            1   // 1 pixel in 8
+#define LCD_PATTERN_25            2   // 1 in 4
+#define LCD_PATTERN_50            3   // checkerboard
+#define LCD_PATTERN_75            4   // 3 in 4
+#define LCD_PATTERN_HORIZONTAL    5   // lines across, every 4 pixels
+#define LCD_PATTERN_VERTICAL      6   // lines down, every 4 pixels
+#define LCD_PATTERN_DIAGONAL      7   // lines down to the right
+#define LCD_PATTERN_BACKDIAGONAL  8   // lines down to the left
+#define LCD_PATTERN_CROSSHATCH    9   // both diagonals
+
+// only font types (see KS0108_fonts.h) have columns - keeps letter (font, c) apart from letter (c, inv)
+template <class Font, byte Columns = Font::columns> struct LCD_isFont { typedef void type; };
+
+// the display, talking through any transport - I2C_graphical_LCD_display (below) is this with
+// the usual transport built in; use KS0108_display directly to supply your own
+
+class KS0108_display : public Print
 {
+  friend class LCD_displayList;   // (KS0108_displaylist.h) reads the screen and sends bytes as they are
+
+protected:
+
+  // how we talk to the LCD - a byte sent on its own (cmd, sendData) is a virtual call,
+  // a run (writeDataRun: flushes, blanking, copies from the cache) one call for the lot
+  KS0108_transport * _transport;
+
 private:
   
-  byte _chipSelect;  // currently-selected chip (LCD_CS1 or LCD_CS2)
-  byte _lcdx;        // current x position (0 - 127)
-  byte _lcdy;        // current y position (0 - 63)
+  byte _chipSelect;  // currently-selected chip (LCD_CS1 to LCD_CS4)
+  byte _chip;        // which chip that is (0 to LCD_CHIPS - 1)
+  byte _lcdx;        // current x position within the chip (0 - 63)
+  byte _lcdy;        // current y position (0 - LCD_HEIGHT - 1)
   
-  byte _port;        // port that the MCP23017 is on (should be 0x20 to 0x27)
-  byte _ssPin;       // if non-zero use SPI rather than I2C (and this is the SS pin)
 
   byte readData ();
-
-#if defined(MCP23x17)
-  void expanderWrite (const byte reg, const byte data);
-  void startSend ();    // prepare for sending to MCP23017  (eg. set SS low)
-  void doSend (const byte what);  // send a byte to the MCP23017
-  void endSend ();      // finished sending  (eg. set SS high)
-#else
-	void do2wireSend (const byte rs, const byte data, const byte enable);		// Send command or data on 2-wire interface
-#endif
+  void sendData (const byte data);  // send a data byte to the selected chip
+  void putData (const byte data);   // write a byte as it is (no inverse or drawing mode), move right
+  // setPixel for the pixels in mask (those in pattern drawn, the rest cleared in LCD_MODE_COPY)
+  void changeBits (const byte x, const byte y, const byte mask, const byte val, const byte pattern = 0xFF);
+  void fillColumn (const byte x, const byte y1, const byte y2, const byte val);   // in the fill pattern
+  byte peekData (const byte x, const byte page);   // from the cache if there is one
+  byte peekRows (const byte x, const int top);     // 8 pixels down from row top
+  boolean peekMoves () const;                      // peekData moves where we are writing
+  void circlePoints (const byte x0, const byte y0, const byte dx, const byte dy, const byte val);
+  void circleColumns (const byte x0, const byte y0, const byte dx, const byte dy, const byte val);
+  byte lastX () const { return width () - 1; }    // right-most pixel, as we are drawing
+  byte lastY () const { return height () - 1; }   // bottom pixel
+  boolean testPattern ();  // write and read back a test pattern, true if it matched
+  void waitReset ();       // until the LCD has finished resetting
+  void wipe ();            // blank the LCD and the cache, quickly
+  void makeRoom (const byte columns);  // go to the next line if a letter this wide won't fit
 
   boolean _invmode;
+  byte _drawMode;    // LCD_MODE_COPY etc.
+  byte _pattern [8]; // fill pattern, a byte for each column (x & 7)
+
+#ifdef LCD_ROTATION
+  byte _orient;      // how to turn logical x,y into physical (see setOrientation), 0 = as is
+  byte _rotX;        // logical x position, when _orient is not 0
+  byte _rotY;        // logical y position
+  int cacheIndex (const byte x, const byte page) const;  // where physical column x, page is in the cache
+  void sendCache (const byte x, const byte page, const byte count);  // send (or queue) count cached bytes
+  void writeRotated (const byte data);
+  byte readRotated () const;
+#endif
   
   const byte * _fMap;		// pointer to current font table
   int _fWidth;		// width of current font
   bool _fSpace;		// should we add a space after each character
   byte _fStart;		// starting character in font
   int _fLength;		// number of chars in current font
+  const uint16_t * _uCodes;   // code point of each letter, for a Unicode font (NULL if not one)
+  unsigned long _utf8Code;    // UTF-8 letter being put together
+  byte _utf8Left;             // bytes of it still to come
+  unsigned int glyphIndex (const unsigned long code) const;
+  void drawGlyph (const unsigned int index, const boolean inv);
+  void textByte (const byte c, const boolean inv);   // UTF-8 with a Unicode font, otherwise a letter
+
+#ifdef LCD_GLYPH_CACHE
+  struct glyphEntry
+  {
+    unsigned int used;    // _glyphTick when last drawn (0 = empty)
+    unsigned int index;   // which letter of the font table
+    boolean inv;          // columns are inverted
+    byte columns [LCD_GLYPH_CACHE_WIDTH];   // ready to send, gap included
+  };
+  glyphEntry _glyphs [LCD_GLYPH_CACHE];
+  unsigned int _glyphTick;    // counts letters drawn, to find the least recently used
+  const byte * cachedGlyph (const unsigned int index, const boolean inv);
+#endif
 
-  byte _clkPin;		// pin for 2-wire CLK
-  byte _dataPin;	// pin for 2-wire DATA
-#if defined(__AVR__) && !defined(MCP23x17)
-  volatile byte * _clkPort;	// CLK port
-  byte _clkMask;	// CLK bitmask
-  volatile byte * _dataPort;	// DATA port
-  byte _dataMask;	// DATA bitmask
-#elif defined(ARDUINO_ARCH_SAMD) && !defined(MCP23x17)
-	volatile uint32_t * _clkPort;
-	uint32_t _clkMask;
-	volatile uint32_t * _dataPort;
-	uint32_t _dataMask;
-#elif defined(ARDUINO_ARCH_ESP8266)
-	uint16_t _clkMask;
-	uint16_t _dataMask;
+#ifdef LCD_REGION_ARENA
+  byte _arena [LCD_REGION_ARENA];   // regions saved without a buffer, most recent last
+  unsigned int _arenaUsed;
 #endif
 
 #ifdef WRITETHROUGH_CACHE
-  byte _cache [64 * 128 / 8];
+  byte _cache [LCD_WIDTH * LCD_HEIGHT / 8];   // 512 bytes per chip: 64 columns of 8 pages
   int  _cacheOffset;
 #endif
+
+#ifdef LCD_GRAYSCALE
+  byte _plane [LCD_WIDTH * LCD_HEIGHT / 8];   // second bitplane (low bit of each level), laid out like the cache
+  byte _grayFirst [LCD_CHIPS * 8];  // first column on each chip/page where the planes may differ (0xFF if none)
+  byte _grayLast [LCD_CHIPS * 8];   // last column where they may differ
+  volatile boolean _grayOn;         // true while the planes are being cycled
+  volatile byte _grayPhase;         // which plane is showing, or being sent
+  byte _grayRow;            // chip/page being sent by grayTick()
+  byte _grayX;              // next column to send on that row
+  byte _grayEnd;            // last column to send on that row
+  byte _grayBudget;         // most bytes grayTick() sends each call
+  unsigned int _grayFrame;  // microseconds per frame
+  unsigned long _grayTime;  // micros() when the plane now showing was finished
+#endif
+
+#ifdef LCD_VERIFY
+  byte _verifyRow;                // chip/page verifyTick() looks at next (chip * 8 + page)
+  unsigned long _verifyChecked;   // lines checked (or sent again) so far
+  unsigned long _verifyRepaired;  // lines found wrong and repainted
+#endif
+
+#ifdef ASYNC_FLUSH
+  byte _dirtyLo [LCD_CHIPS * 8];    // first changed column on each chip/page (0xFF if none)
+  byte _dirtyHi [LCD_CHIPS * 8];    // last changed column on each chip/page
+  volatile boolean _flushBusy;   // true while flushAsync() has work to do
+  byte _flushRow;           // chip/page being sent by flushTick() (chip * 8 + page)
+  byte _flushX;             // next column to send on that row
+  byte _flushEnd;           // last column to send on that row
+  void (*_flushDone) ();    // called when an asynchronous flush has finished
+  void markDirty (const byte row, const byte lo, const byte hi);  // columns lo..hi of row need sending
+  boolean startRun (const boolean shortest);  // take the next row of changes to send, false if none
+  byte sendRun (const byte maxBytes);         // send some of it, returns how many bytes
+#endif
+
+#if defined(LCD_VERIFY) || defined(LCD_GRAYSCALE)
+  void restoreAddress (const byte chipSelects);  // put back the address others were using on these chips
+#endif
   
 public:
   
-  // constructor
-#if defined(MCP23x17)
-  I2C_graphical_LCD_display () : _port (0x20), _ssPin (10), _invmode(false), _clkPin(0), _dataPin(0) {};
-#else
-  I2C_graphical_LCD_display (const byte clkPin, const byte dataPin) :
-								_port (0x20), _ssPin(0), _invmode(false)
-								{_clkPin = clkPin; _dataPin = dataPin;};
-#endif
+  // talk through the given transport (eg. for several displays on different interfaces)
+  KS0108_display (KS0108_transport & transport) : _transport (&transport), _invmode(false) {};
 
-  void begin (const byte port = 0x20, const byte i2cAddress = 0, const byte ssPin = 0);
+  void begin (const LCD_timing & timing = LCD_timing ());
   void cmd (const byte data);
   void gotoxy (byte x, byte y);
   void writeData (byte data, const boolean inv);
@@ -351,28 +667,55 @@ public:
   void letter (byte c) {letter(c, _invmode);}
   void string (const char * s, const boolean inv);
   void string (const char * s) {string(s, _invmode);}
+  byte glyphColumn (byte c, const byte col) const;  // column col of letter c in the current font (bit 0 at the top)
+
+  // letters from a font whose size is fixed at compile time (see KS0108_fonts.h) - the
+  // current font (setFont) is not changed
+  template <class Font> void letter (const Font & font, const byte c, const boolean inv)
+    {
+    makeRoom (Font::columns);
+    const byte * p = font.glyph (c);    // in PROGMEM, NULL if not in the font
+    for (byte x = 0; x < Font::width; x++)
+      writeData (p ? pgm_read_byte (p + x) : 0, inv);
+    if (Font::space)
+      writeData (0, inv);  // one-pixel gap between letters
+    }
+  template <class Font> typename LCD_isFont <Font>::type letter (const Font & font, const byte c) { letter (font, c, _invmode); }
+  template <class Font> void string (const Font & font, const char * s, const boolean inv)
+    {
+    while (*s)
+      letter (font, *s++, inv);
+    }
+  template <class Font> typename LCD_isFont <Font>::type string (const Font & font, const char * s) { string (font, s, _invmode); }
+  byte glyphWidth () const { return _fWidth + (_fSpace ? 1 : 0); }  // columns each letter takes, with its gap
   void blit (const byte * pic, const unsigned int size);
+  void blitRLE (const byte * pic, unsigned int size);  // as blit, for pictures packed by ks0108conv -z
+  void drawGrayImage (const byte x,         // top-left corner
+                      const byte y,
+                      const byte w,         // size of picture
+                      const byte h,
+                      const byte * pic);    // w x h bytes in PROGMEM, row by row, 0 = black to 255 = white
   void clear (const byte x1 = 0,    // start pixel
               const byte y1 = 0,     
-              const byte x2 = 127,  // end pixel
-              const byte y2 = 63,   
+              const byte x2 = 0xFF,   // end pixel (0xFF = right edge)
+              const byte y2 = 0xFF,   // (0xFF = bottom edge)
               const byte val = 0);   // what to fill with 
   void setPixel (const byte x, const byte y, const byte val = 1);
   void fillRect (const byte x1 = 0,   // start pixel
                 const byte y1 = 0,     
-                const byte x2 = 127, // end pixel
-                const byte y2 = 63,    
+                const byte x2 = 0xFF,   // end pixel (0xFF = right edge)
+                const byte y2 = 0xFF,   // (0xFF = bottom edge)
                 const byte val = 1);  // what to draw (0 = white, 1 = black) 
   void frameRect (const byte x1 = 0,    // start pixel
                  const byte y1 = 0,     
-                 const byte x2 = 127, // end pixel
-                 const byte y2 = 63,    
+                 const byte x2 = 0xFF,   // end pixel (0xFF = right edge)
+                 const byte y2 = 0xFF,   // (0xFF = bottom edge)
                  const byte val = 1,    // what to draw (0 = white, 1 = black) 
                  const byte width = 1);
   void line  (const byte x1 = 0,    // start pixel
               const byte y1 = 0,     
-              const byte x2 = 127,  // end pixel
-              const byte y2 = 63,   
+              const byte x2 = LCD_WIDTH - 1, // end pixel
+              const byte y2 = LCD_HEIGHT - 1,
               const byte val = 1);  // what to draw (0 = white, 1 = black) 
   void scroll (const byte y = 0);   // set scroll position
   void circle (const byte x = 0,		// center point x
@@ -383,19 +726,158 @@ public:
 					 const byte y = 0,		// center point y
 					 const byte r = 1,		// radius
 					 const byte val = 1);	// color (0 = white, 1 = black)
+  void fillTriangle (const int x1, const int y1,    // corners (may be off the screen)
+                     const int x2, const int y2,
+                     const int x3, const int y3,
+                     const byte val = 1);   // what to draw (0 = white, 1 = black)
+  void fillPolygon (const int * points,   // x, y of each corner in turn (may be off the screen)
+                    const byte count,     // how many corners
+                    const byte val = 1);  // what to draw (0 = white, 1 = black)
 
 #if defined(ARDUINO) && ARDUINO >= 100
-	virtual size_t write(uint8_t c) {letter(c, _invmode); return 1; }
+	virtual size_t write(uint8_t c) {textByte(c, _invmode); return 1; }
 #else
 	void write(uint8_t c) { letter(c, _invmode); }
 #endif
 
 	void setInv(boolean inv) {_invmode = inv;} // set inverse mode state true == inverse
+
+  // how drawing combines with the screen: LCD_MODE_COPY, LCD_MODE_SET, LCD_MODE_CLEAR or LCD_MODE_XOR
+  // applies to everything: pixels, shapes, text, blit and clear
+  void setDrawMode (const byte mode) { _drawMode = mode; }
+  byte getDrawMode () const { return _drawMode; }
+
+  // what fills (fillRect, fillCircle, fillTriangle, fillPolygon) draw: black where the pattern
+  // has a 1, and (in LCD_MODE_COPY) white where it has a 0 - lines, outlines and pixels are solid
+  // the pattern lines up with the screen, so fills next to each other join up
+  void setPattern (byte which);                 // LCD_PATTERN_SOLID etc.
+  void setUserPattern (const byte * columns);   // 8 bytes in RAM, one for each column (bit 0 at the top)
+  void invertRect (const byte x1 = 0,    // start pixel
+                   const byte y1 = 0,
+                   byte x2 = 0xFF,       // end pixel (0xFF = right edge)
+                   byte y2 = 0xFF);      // (0xFF = bottom edge)
+  void copyRect (const byte sx,    // top-left corner to copy from
+                 const byte sy,
+                 byte w,           // size
+                 byte h,
+                 const byte dx,    // top-left corner to copy to (may overlap)
+                 const byte dy);
+  void scrollRegion (const byte x1,    // left column
+                     const byte y1,    // top (forced to an 8-pixel line)
+                     byte x2,          // right column (inclusive)
+                     byte y2,          // bottom (inclusive)
+                     const int dx,     // pixels to move right (negative for left)
+                     const byte * columns = NULL);  // new columns: dx bytes for each line, or NULL for blank
+
+  // keep what is on the screen under a popup or menu, and put it back afterwards - the rectangle
+  // is forced to 8-pixel lines as for clear, and buffer needs LCD_REGION_SIZE (x1, y1, x2, y2) bytes
+  // with no buffer the region arena is used (LCD_REGION_ARENA): regions come back in the reverse order
+  // they were saved, and these return false if there is no room, or nothing saved
+  boolean saveRegion (const byte x1, const byte y1, byte x2, byte y2, byte * buffer = NULL);
+  boolean restoreRegion (const byte x1, const byte y1, byte x2, byte y2, const byte * buffer = NULL);
+
+#ifdef LCD_ROTATION
+  // rotation: 0 to 3, times 90 degrees clockwise; then optionally mirror left/right and/or top/bottom
+  // what is already on the screen is left where it is, so clear or redraw afterwards
+  void setOrientation (const byte rotation, const boolean mirrorX = false, const boolean mirrorY = false);
+  byte width () const  { return (_orient & 1) ? LCD_HEIGHT : LCD_WIDTH; }   // as we are drawing it
+  byte height () const { return (_orient & 1) ? LCD_WIDTH : LCD_HEIGHT; }
+#else
+  byte width () const  { return LCD_WIDTH; }
+  byte height () const { return LCD_HEIGHT; }
+#endif
+
+  void setBusyDelay (const byte us) {_transport->setBusyDelay (us);}  // microseconds between LCD operations (SPI)
+  byte getBusyDelay () const {return _transport->getBusyDelay ();}
+  byte calibrateBusyDelay ();     // find the shortest busy delay that works (SPI)
+  unsigned long tuneBusClock ();  // find the fastest I2C or SPI clock that works
+  unsigned int busErrors () const {return _transport->busErrors ();}  // transfers the bus reported failed (I2C)
+
+#ifdef LCD_VERIFY
+  // check the next line (8 pixels deep) of one chip against the cache, and repaint it if
+  // it differs - or, if the LCD can't be read back, just send it again
+  // returns true if it was read back and found wrong; call it every so often (eg. from loop)
+  // to go round the whole screen, a line at a time (does nothing while a flush or grayscale is running)
+  boolean verifyTick ();
+  unsigned long verifyChecked () const  { return _verifyChecked; }   // lines checked (or sent again) so far
+  unsigned long verifyRepaired () const { return _verifyRepaired; }  // read back wrong, and repainted
+  void resetVerifyCounts () { _verifyChecked = 0; _verifyRepaired = 0; }
+#endif
+
+#ifdef LCD_GRAYSCALE
+  // level: 0 (white), 1 (light gray), 2 (dark gray) or 3 (black)
+  // drawing with the normal functions gives levels 0 and 3
+  void setGrayPixel (const byte x, const byte y, const byte level);
+  byte getGrayPixel (const byte x, const byte y);
+  void fillGrayRect (const byte x1, const byte y1, byte x2, byte y2, const byte level);
+  // start (or stop) cycling the planes: frame length in microseconds, and the most bytes
+  // to send on each call of grayTick() (with Timer2 calling it, keep this to 1 or 2)
+  void setGrayscale (const boolean on, const unsigned int frameMicros = 5000, const byte budget = 32);
+  boolean grayTick ();    // send the next bit of a plane change, false once stopped
+#endif
+
+#ifdef ASYNC_FLUSH
+  void flush ();                                // send all changes now, wait until done
+  void flushAsync (void (*done) () = NULL);     // start sending changes in the background
+  boolean flushTick (byte maxBytes = 1);        // send up to maxBytes, false when finished
+  boolean isBusy () const { return _flushBusy; }  // true until flushAsync() has finished
+  // for cooperative main loops: send changes until the budget runs out, picking up where the
+  // last call left off - rows with the fewest changes go first, so small changes (a digit,
+  // a cursor) show up straight away while a big one (clear, a full-screen blit) is still
+  // going; each returns the number of bytes still to send (0 once the LCD is up to date)
+  unsigned int flushSome (unsigned int maxBytes);      // send up to maxBytes
+  unsigned int flushFor (const unsigned long maxMicros);  // send for up to maxMicros (at least a few bytes)
+  unsigned int pending () const;                       // bytes waiting to be sent
+#endif
+	static const byte * defaultFont ();    // the built-in 5 x 8 font, for LCD_font (KS0108_fonts.h)
 	void setFont(const void * fontMap = NULL,			// Set font table (assumed in PROGMEM)
 				 const int width = 5,			// Width of a character
 				 const bool space = true,		// Add space after each character?
 				 const byte start = 0x20,		// First character in font
 				 const int length = 96);		// Number of characters in font
+	void setUnicodeFont(const uint16_t * codes,		// code points, ascending (PROGMEM)
+						const void * glyphs,		// a letter for each (PROGMEM)
+						const unsigned int count,	// how many letters
+						const int width = 5,		// Width of a character
+						const bool space = true);	// Add space after each character?
+	template <class Font> void setUnicodeFont(const Font & font)	// an LCD_unicodeFont (KS0108_fonts.h)
+		{ setUnicodeFont(font.codes, font.glyphs, Font::count, Font::width, Font::space); }
+};
+
+
+// the display with the transport the defines above pick: the 2-wire board (pins given here),
+// or the MCP23017 / MCP23S17 (chosen by begin()) - built in only here, so a KS0108_display
+// given its own transport carries no unused one
+
+class I2C_graphical_LCD_display : public KS0108_display
+{
+private:
+
+#if defined(MCP23017)
+  KS0108_MCP23017 _i2c;       // used by begin () with no SS pin
+#endif
+#if defined(MCP23S17)
+  KS0108_MCP23S17 _spi;       // used by begin () with an SS pin
+#endif
+#if !defined(MCP23x17)
+  KS0108_2wire _2wire;
+#endif
+
+public:
+
+  // constructor (the base only keeps the transport's address, so it may come first)
+#if defined(MCP23017)
+  I2C_graphical_LCD_display () : KS0108_display (_i2c) {};
+#elif defined(MCP23S17)
+  I2C_graphical_LCD_display () : KS0108_display (_spi) {};
+#else
+  // with HC595_SPI / HC595_SPI_LATCH, clkPin and dataPin are ignored (the SPI pins are used)
+  I2C_graphical_LCD_display (const byte clkPin, const byte dataPin, const byte latchPin = 0) :
+								KS0108_display (_2wire), _2wire (clkPin, dataPin, latchPin) {};
+#endif
+
+  void begin (const byte port = 0x20, const byte i2cAddress = 0, const byte ssPin = 0);
+  void begin (const LCD_timing & timing, const byte port = 0x20, const byte i2cAddress = 0, const byte ssPin = 0);
 };
 
 #endif  // I2C_graphical_LCD_display_H
@@ -0,0 +1,538 @@
+/*
+ KS0108_displaylist.cpp
+
+ Display lists for the I2C_graphical_LCD_display library - see KS0108_displaylist.h
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#include "KS0108_displaylist.h"
+
+// ---------------------------------------------------------------------------
+//  recording
+// ---------------------------------------------------------------------------
+
+void LCD_displayList::reset ()
+{
+  _length = 0;
+  if (_buffer && _size)
+    _buffer [0] = LCD_OP_END;
+}  // end of LCD_displayList::reset
+
+// put an entry on the end: the op, count bytes of args, then room for extra bytes more
+// which the caller fills in - returns false if there isn't room (or the list is in PROGMEM)
+boolean LCD_displayList::add (const byte op,
+                              const byte * args,
+                              const byte count,
+                              const unsigned int extra)
+{
+  // (and one for LCD_OP_END)
+  if (_buffer == NULL || _length + 1 + count + extra + 1 > _size)
+    return false;
+
+  _buffer [_length] = op;
+  memcpy (&_buffer [_length + 1], args, count);
+  _buffer [_length + 1 + count + extra] = LCD_OP_END;
+  _length += 1 + count + extra;
+  return true;
+}  // end of LCD_displayList::add
+
+boolean LCD_displayList::clear (const byte x1,
+                                const byte y1,
+                                const byte x2,
+                                const byte y2,
+                                const byte val)
+{
+  const byte args [] = { x1, y1, x2, y2, val };
+  return add (LCD_OP_CLEAR, args, sizeof args);
+}  // end of LCD_displayList::clear
+
+boolean LCD_displayList::fillRect (const byte x1,
+                                   const byte y1,
+                                   const byte x2,
+                                   const byte y2,
+                                   const byte val)
+{
+  const byte args [] = { x1, y1, x2, y2, val };
+  return add (LCD_OP_FILL, args, sizeof args);
+}  // end of LCD_displayList::fillRect
+
+boolean LCD_displayList::frameRect (const byte x1,
+                                    const byte y1,
+                                    const byte x2,
+                                    const byte y2,
+                                    const byte val,
+                                    const byte width)
+{
+  const byte args [] = { x1, y1, x2, y2, val, width };
+  return add (LCD_OP_FRAME, args, sizeof args);
+}  // end of LCD_displayList::frameRect
+
+boolean LCD_displayList::line (const byte x1,
+                               const byte y1,
+                               const byte x2,
+                               const byte y2,
+                               const byte val)
+{
+  const byte args [] = { x1, y1, x2, y2, val };
+  return add (LCD_OP_LINE, args, sizeof args);
+}  // end of LCD_displayList::line
+
+boolean LCD_displayList::setPixel (const byte x,
+                                   const byte y,
+                                   const byte val)
+{
+  const byte args [] = { x, y, val };
+  return add (LCD_OP_PIXEL, args, sizeof args);
+}  // end of LCD_displayList::setPixel
+
+boolean LCD_displayList::string (const byte x,
+                                 const byte y,
+                                 const char * s,
+                                 const boolean inv)
+{
+  const byte args [] = { x, y, inv };
+  const unsigned int letters = strlen (s) + 1;   // with the 0
+  if (!add (LCD_OP_TEXT, args, sizeof args, letters))
+    return false;
+
+  memcpy (&_buffer [_length - letters], s, letters);
+  return true;
+}  // end of LCD_displayList::string
+
+boolean LCD_displayList::blit (const byte x,
+                               const byte y,
+                               const byte w,
+                               const byte h,
+                               const byte * pic)
+{
+  const byte args [] = { x, y, w, h };
+  if (!add (LCD_OP_BLIT, args, sizeof args, sizeof pic))
+    return false;
+
+  memcpy (&_buffer [_length - sizeof pic], &pic, sizeof pic);
+  return true;
+}  // end of LCD_displayList::blit
+
+
+// ---------------------------------------------------------------------------
+//  reading the list
+// ---------------------------------------------------------------------------
+
+// is there an entry at i?
+boolean LCD_displayList::more (const unsigned int i) const
+{
+  if (_buffer)
+    return i < _length;
+
+  const byte op = get (i);
+  return op != LCD_OP_END && op <= LCD_OP_BLIT;
+}  // end of LCD_displayList::more
+
+unsigned int LCD_displayList::next (unsigned int i) const
+{
+  switch (get (i))
+    {
+    case LCD_OP_PIXEL:  return i + 4;
+    case LCD_OP_FRAME:  return i + 7;
+    case LCD_OP_BLIT:   return i + 5 + sizeof (const byte *);
+    case LCD_OP_BITMAP: return i + 5 + get (i + 3) * ((get (i + 4) + 7) >> 3);
+    case LCD_OP_TEXT:
+      for (i += 4; get (i); i++)
+        { }
+      return i + 1;
+    default:            return i + 6;   // clear, fill, line
+    }
+}  // end of LCD_displayList::next
+
+// where the picture for the LCD_OP_BLIT at i is (in PROGMEM)
+const byte * LCD_displayList::address (const unsigned int i) const
+{
+  const byte * pic;
+  memcpy (&pic, &_list [i + 5], sizeof pic);
+  return pic;
+}  // end of LCD_displayList::address
+
+// the bits in line page for rows from..to (inclusive)
+byte LCD_displayList::rows (const byte page,
+                            int from,
+                            int to)
+{
+  from -= page << 3;
+  to -= page << 3;
+  if (from < 0)
+    from = 0;
+  if (to > 7)
+    to = 7;
+  if (from > to)
+    return 0;
+
+  return (0xFF << from) & (0xFF >> (7 - to));
+}  // end of LCD_displayList::rows
+
+// which columns the entry at i may change on line page (false if none)
+boolean LCD_displayList::span (const KS0108_display & lcd,
+                               const unsigned int i,
+                               const byte page,
+                               int & left,
+                               int & right) const
+{
+  const int lastX = lcd.width () - 1;
+  const int lastY = lcd.height () - 1;
+  int top, bottom;
+
+  left = get (i + 1);
+  switch (get (i))
+    {
+    case LCD_OP_CLEAR:
+      {
+      // as clear, which goes down 8 rows at a time from y1
+      const int y1 = get (i + 2);
+      const int y2 = get (i + 4) < lastY ? get (i + 4) : lastY;
+      top = y1;
+      bottom = y2 < y1 ? -1 : y1 + ((y2 - y1) & ~7);
+      right = get (i + 3);
+      break;
+      }
+
+    case LCD_OP_FILL:
+    case LCD_OP_FRAME:
+      top = get (i + 2);
+      right = get (i + 3);
+      bottom = get (i + 4);
+      break;
+
+    case LCD_OP_LINE:
+      {
+      // line steps towards the end along the longer side, but can go either way along
+      // the shorter one - so allow for that going as far the wrong way as the right way
+      const int x1 = left, y1 = get (i + 2), x2 = get (i + 3), y2 = get (i + 4);
+      const int dx = abs (x2 - x1), dy = abs (y2 - y1);
+      left = (x1 < x2 ? x1 : x2) - dx;
+      right = (x1 < x2 ? x2 : x1) + dx;
+      top = (y1 < y2 ? y1 : y2) - dy;
+      bottom = (y1 < y2 ? y2 : y1) + dy;
+      // (and the pixel positions are bytes, so that can wrap round to the other side)
+      if (left < 0 || right > 255)
+        {
+        left = 0;
+        right = lastX;
+        }
+      if (top < 0 || bottom > 255)
+        {
+        top = 0;
+        bottom = lastY;
+        }
+      break;
+      }
+
+    case LCD_OP_PIXEL:
+      top = bottom = get (i + 2);
+      right = left;
+      break;
+
+    case LCD_OP_TEXT:
+      {
+      unsigned int letters = 0;
+      while (get (i + 4 + letters))
+        letters++;
+      top = get (i + 2) & ~7;
+      bottom = top + 7;
+      right = left + (long) letters * lcd.glyphWidth () - 1;
+      break;
+      }
+
+    default:  // bitmap and blit
+      top = get (i + 2) & ~7;
+      bottom = top + get (i + 4) - 1;
+      right = left + get (i + 3) - 1;
+      break;
+    }
+
+  if (left < 0)
+    left = 0;
+  if (right > lastX)
+    right = lastX;
+  if (top < 0)
+    top = 0;
+  if (bottom > lastY)
+    bottom = lastY;
+  return left <= right && top <= bottom && (top >> 3) <= page && (bottom >> 3) >= page;
+}  // end of LCD_displayList::span
+
+
+// ---------------------------------------------------------------------------
+//  drawing
+// ---------------------------------------------------------------------------
+
+// change the bits in mask of column x (if it is in this batch) to those in bits - the
+// byte is read from the screen the first time, unless all 8 pixels are being set
+void LCD_displayList::change (KS0108_display & lcd,
+                              batch & b,
+                              const int x,
+                              const byte mask,
+                              const byte bits)
+{
+  if (x < b.x || x >= b.x + b.count || !mask)
+    return;
+
+  const byte c = x - b.x;
+  if (!(b.have & (1UL << c)))
+    {
+    if (mask == 0xFF)
+      b.bytes [c] = 0;
+    else
+      {
+      b.bytes [c] = lcd.peekData (x, b.page);
+      b.peeked = true;
+      }
+    b.have |= 1UL << c;
+    }
+  b.bytes [c] = (b.bytes [c] & ~mask) | (bits & mask);
+}  // end of LCD_displayList::change
+
+// draw the entry at i into the batch
+void LCD_displayList::paint (KS0108_display & lcd,
+                             const unsigned int i,
+                             batch & b) const
+{
+  int left, right;
+  if (!span (lcd, i, b.page, left, right))
+    return;
+
+  // just the columns in the batch
+  if (left < b.x)
+    left = b.x;
+  if (right > b.x + b.count - 1)
+    right = b.x + b.count - 1;
+  if (left > right)
+    return;   // not in this batch
+
+  const byte val = get (i + 5);
+  const byte ink = val ? 0xFF : 0;
+  int x;
+
+  switch (get (i))
+    {
+    case LCD_OP_CLEAR:
+      for (x = left; x <= right; x++)
+        change (lcd, b, x, 0xFF, val);
+      break;
+
+    case LCD_OP_FILL:
+      {
+      const byte mask = rows (b.page, get (i + 2), get (i + 4));
+      for (x = left; x <= right; x++)
+        change (lcd, b, x, mask, val ? lcd._pattern [x & 7] : 0);
+      break;
+      }
+
+    case LCD_OP_FRAME:
+      {
+      // as frameRect: the left and right sides go all the way down, the rest just has
+      // the top and bottom lines (after cutting it off at the edges of the screen)
+      const int x1 = get (i + 1), y1 = get (i + 2);
+      const int x2 = get (i + 3) < lcd.width () ? get (i + 3) : lcd.width () - 1;
+      const int y2 = get (i + 4) < lcd.height () ? get (i + 4) : lcd.height () - 1;
+      const int width = get (i + 6);
+      const byte side = rows (b.page, y1, y2);
+      const byte across = (rows (b.page, y1, y1 + width - 1) | rows (b.page, y2 - width + 1, y2)) & side;
+      for (x = left; x <= right; x++)
+        change (lcd, b, x, (x - x1 < width || x2 - x < width) ? side : across, ink);
+      break;
+      }
+
+    case LCD_OP_PIXEL:
+      change (lcd, b, left, 1 << (get (i + 2) & 7), get (i + 3) ? 0xFF : 0);
+      break;
+
+    case LCD_OP_LINE:
+      {
+      // the same steps as KS0108_display::line, so the same pixels are drawn
+      const byte x1 = get (i + 1), y1 = get (i + 2), x2 = get (i + 3), y2 = get (i + 4);
+      const int lastY = lcd.height () - 1;
+      const int first = b.page << 3;
+
+      if (x1 == x2)
+        {
+        for (int y = y1 > first ? y1 : first; y <= y2 && y <= first + 7 && y <= lastY; y++)
+          change (lcd, b, x1, 1 << (y & 7), ink);
+        break;
+        }
+      if (y1 == y2)
+        {
+        if (y1 <= lastY && x1 <= x2)
+          for (x = x1 > left ? x1 : left; x <= right && x <= x2; x++)
+            change (lcd, b, x, 1 << (y1 & 7), ink);
+        break;
+        }
+
+      const int x_diff = x2 - x1,
+                y_diff = y2 - y1;
+      if (abs (x_diff) > abs (y_diff))
+        {
+        const int x_inc = x_diff < 0 ? -1 : 1;
+        const int y_inc = (y_diff << 8) / x_diff;
+        int y_temp = y1 << 8;
+        for (x = x1; x != x2; x += x_inc)
+          {
+          const byte y = y_temp >> 8;
+          if ((y >> 3) == b.page && y <= lastY)
+            change (lcd, b, x, 1 << (y & 7), ink);
+          y_temp += y_inc;
+          }
+        break;
+        }
+
+      const int x_inc = (x_diff << 8) / y_diff;
+      const int y_inc = y_diff < 0 ? -1 : 1;
+      int x_temp = x1 << 8;
+      for (int y = y1; y != y2; y += y_inc)
+        {
+        if ((y >> 3) == b.page)
+          change (lcd, b, (byte) (x_temp >> 8), 1 << (y & 7), ink);
+        x_temp += x_inc;
+        }
+      if ((y2 >> 3) == b.page)
+        change (lcd, b, x2, 1 << (y2 & 7), ink);
+      break;
+      }
+
+    case LCD_OP_TEXT:
+      {
+      // only the letters in the batch
+      const byte glyphWidth = lcd.glyphWidth ();
+      const int x1 = get (i + 1);
+      const byte inv = get (i + 3) ? 0xFF : 0;
+      for (x = left; x <= right; x++)
+        {
+        const byte col = (x - x1) % glyphWidth;
+        change (lcd, b, x, 0xFF, lcd.glyphColumn (get (i + 4 + (x - x1) / glyphWidth), col) ^ inv);
+        }
+      break;
+      }
+
+    default:  // bitmap and blit
+      {
+      const int x1 = get (i + 1);
+      const byte w = get (i + 3);
+      const byte line = b.page - (get (i + 2) >> 3);   // of the picture
+      const byte mask = rows (line, 0, get (i + 4) - 1);
+      const unsigned int from = line * w;
+      for (x = left; x <= right; x++)
+        change (lcd, b, x, mask, get (i) == LCD_OP_BITMAP ? get (i + 5 + from + x - x1)
+                                                          : pgm_read_byte (address (i) + from + x - x1));
+      break;
+      }
+    }
+}  // end of LCD_displayList::paint
+
+// go through the screen a line at a time, and each line in batches of up to 32 columns:
+// every entry is drawn into the batch, then the bytes that were touched are sent, each
+// stretch of them as one run after a gotoxy (a stretch carrying on from the batch before
+// just carries on)
+unsigned int LCD_displayList::draw (KS0108_display & lcd) const
+{
+  unsigned int sent = 0;
+  const byte lines = lcd.height () >> 3;
+  unsigned int i;
+
+  for (byte page = 0; page < lines; page++)
+    {
+    // the columns anything touches on this line
+    int left = lcd.width (), right = -1;
+    for (i = 0; more (i); i = next (i))
+      {
+      int l, r;
+      if (span (lcd, i, page, l, r))
+        {
+        if (l < left)
+          left = l;
+        if (r > right)
+          right = r;
+        }
+      }
+
+    int at = -1;    // where the LCD will put the next byte sent (-1 if not known)
+    for (int x = left; x <= right; x += 32)
+      {
+      batch b;
+      b.page = page;
+      b.x = x;
+      b.count = right - x + 1 < 32 ? right - x + 1 : 32;
+      b.have = 0;
+      b.peeked = false;
+
+      for (i = 0; more (i); i = next (i))
+        paint (lcd, i, b);
+      if (b.peeked)
+        at = -1;    // reading the screen moved us
+
+      byte c = 0;
+      while (c < b.count)
+        {
+        if (!(b.have & (1UL << c)))
+          {
+          c++;
+          continue;
+          }
+        // (carrying on from the last batch needs no gotoxy)
+        if (b.x + c != at)
+          lcd.gotoxy (b.x + c, page << 3);
+        for ( ; c < b.count && (b.have & (1UL << c)); c++, sent++)
+          lcd.putData (b.bytes [c]);
+        at = b.x + c;
+        }
+      }  // end of for each batch
+    }  // end of for each line
+
+  return sent;
+}  // end of LCD_displayList::draw
+
+// print the list as PROGMEM array contents, an entry to a line
+void LCD_displayList::dump (Print & out) const
+{
+  for (unsigned int i = 0; more (i); i = next (i))
+    {
+    const byte op = get (i);
+    switch (op)
+      {
+      case LCD_OP_CLEAR:  out.print (F("LCD_LIST_CLEAR ("));  break;
+      case LCD_OP_FILL:   out.print (F("LCD_LIST_FILL ("));   break;
+      case LCD_OP_FRAME:  out.print (F("LCD_LIST_FRAME ("));  break;
+      case LCD_OP_LINE:   out.print (F("LCD_LIST_LINE ("));   break;
+      case LCD_OP_PIXEL:  out.print (F("LCD_LIST_PIXEL ("));  break;
+      case LCD_OP_TEXT:   out.print (F("LCD_LIST_TEXT ("));   break;
+      default:            out.print (F("LCD_LIST_BITMAP (")); break;   // blit too, with the picture copied in
+      }
+
+    // the arguments, up to the letters or picture
+    const byte count = op == LCD_OP_TEXT ? 3 : op >= LCD_OP_BITMAP ? 4 : next (i) - i - 1;
+    for (byte j = 1; j <= count; j++)
+      {
+      out.print (get (i + j));
+      out.print (j < count ? F(", ") : F("),"));
+      }
+
+    if (op == LCD_OP_TEXT)
+      for (unsigned int j = i + 4; j < next (i); j++)
+        {
+        out.print (F(" "));
+        out.print (get (j));
+        out.print (F(","));
+        }
+    else if (op >= LCD_OP_BITMAP)
+      {
+      const unsigned int size = get (i + 3) * ((get (i + 4) + 7) >> 3);
+      for (unsigned int j = 0; j < size; j++)
+        {
+        out.print (F(" "));
+        out.print (op == LCD_OP_BITMAP ? get (i + 5 + j) : pgm_read_byte (address (i) + j));
+        out.print (F(","));
+        }
+      }
+    out.println ();
+    }
+  out.println (F("LCD_LIST_END"));
+}  // end of LCD_displayList::dump
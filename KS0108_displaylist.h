@@ -0,0 +1,126 @@
+/*
+ KS0108_displaylist.h
+
+ Display lists for the I2C_graphical_LCD_display library.
+
+ A static screen (a menu, a frame with labels) is normally drawn by dozens of calls to clear,
+ frameRect, line, string and blit, each of which goes to the LCD on its own - so bytes where
+ several of them meet are read and sent several times. Instead, record the calls once into an
+ LCD_displayList, and draw() it whenever the screen is wanted. The list is drawn a line
+ (8 pixels deep) at a time, in batches of columns: every call in the list is applied to the
+ batch in RAM, then each byte it touched is sent once, in runs after a single gotoxy.
+
+ Lists can be recorded into a buffer in RAM as the program runs, or kept in PROGMEM - written
+ with the LCD_LIST_ macros below, or recorded once and printed with dump() to paste into a sketch.
+
+ Each entry is an op code followed by its arguments, all bytes, ending with LCD_OP_END:
+
+   LCD_OP_CLEAR   x1 y1 x2 y2 val        as clear (val is the byte to fill with)
+   LCD_OP_FILL    x1 y1 x2 y2 val        as fillRect (in the fill pattern when drawn)
+   LCD_OP_FRAME   x1 y1 x2 y2 val width  as frameRect
+   LCD_OP_LINE    x1 y1 x2 y2 val        as line
+   LCD_OP_PIXEL   x y val                as setPixel
+   LCD_OP_TEXT    x y inv  letters 0     letters in the current font, from gotoxy (x, y)
+   LCD_OP_BITMAP  x y w h  bytes         w bytes for each line of 8 pixels down, as for blit
+   LCD_OP_BLIT    x y w h  address       the same, from a picture in PROGMEM (RAM lists only)
+
+ Everything is drawn as in LCD_MODE_COPY, whatever the drawing mode is, and not inverted unless
+ the entry says so. Text and pictures go on whole lines (y is rounded down to a multiple of 8).
+ Text is not wrapped (it stops at the right edge), and is one byte per letter.
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#ifndef KS0108_displaylist_H
+#define KS0108_displaylist_H
+
+#include "I2C_graphical_LCD_display.h"
+
+#define LCD_OP_END      0
+#define LCD_OP_CLEAR    1
+#define LCD_OP_FILL     2
+#define LCD_OP_FRAME    3
+#define LCD_OP_LINE     4
+#define LCD_OP_PIXEL    5
+#define LCD_OP_TEXT     6
+#define LCD_OP_BITMAP   7
+#define LCD_OP_BLIT     8
+
+// for writing lists in PROGMEM, eg.
+//   const byte menu [] PROGMEM = { LCD_LIST_CLEAR (0, 0, 127, 63, 0),
+//                                  LCD_LIST_FRAME (0, 0, 127, 63, 1, 1),
+//                                  LCD_LIST_TEXT (4, 8, false), 'M', 'e', 'n', 'u', 0,
+//                                  LCD_LIST_END };
+#define LCD_LIST_CLEAR(x1, y1, x2, y2, val)          LCD_OP_CLEAR, (x1), (y1), (x2), (y2), (val)
+#define LCD_LIST_FILL(x1, y1, x2, y2, val)           LCD_OP_FILL, (x1), (y1), (x2), (y2), (val)
+#define LCD_LIST_FRAME(x1, y1, x2, y2, val, width)   LCD_OP_FRAME, (x1), (y1), (x2), (y2), (val), (width)
+#define LCD_LIST_LINE(x1, y1, x2, y2, val)           LCD_OP_LINE, (x1), (y1), (x2), (y2), (val)
+#define LCD_LIST_PIXEL(x, y, val)                    LCD_OP_PIXEL, (x), (y), (val)
+#define LCD_LIST_TEXT(x, y, inv)                     LCD_OP_TEXT, (x), (y), (inv)   // then the letters, and 0
+#define LCD_LIST_BITMAP(x, y, w, h)                  LCD_OP_BITMAP, (x), (y), (w), (h)   // then the bytes
+#define LCD_LIST_END                                 LCD_OP_END
+
+class LCD_displayList
+{
+public:
+
+  // record into buffer (in RAM) - a byte is kept for LCD_OP_END
+  LCD_displayList (byte * buffer, const unsigned int size) :
+                   _list (buffer), _buffer (buffer), _size (size), _length (0) { reset (); }
+  // play back a list in PROGMEM (ending with LCD_LIST_END) - it can't be added to
+  LCD_displayList (const byte * list) : _list (list), _buffer (NULL), _size (0), _length (0) {}
+
+  // recording: each returns false (and leaves the list as it was) if there is no room
+  boolean clear (const byte x1 = 0, const byte y1 = 0, const byte x2 = 0xFF, const byte y2 = 0xFF, const byte val = 0);
+  boolean fillRect (const byte x1, const byte y1, const byte x2, const byte y2, const byte val = 1);
+  boolean frameRect (const byte x1, const byte y1, const byte x2, const byte y2, const byte val = 1, const byte width = 1);
+  boolean line (const byte x1, const byte y1, const byte x2, const byte y2, const byte val = 1);
+  boolean setPixel (const byte x, const byte y, const byte val = 1);
+  boolean string (const byte x, const byte y, const char * s, const boolean inv = false);   // s is copied
+  // w x h pixels, w bytes for each line of 8 pixels down (as for blit) - pic is not copied
+  boolean blit (const byte x, const byte y, const byte w, const byte h, const byte * pic);
+
+  void reset ();                                    // empty the list, to record it again
+  unsigned int length () const { return _length; }  // bytes recorded (not counting LCD_OP_END)
+
+  // draw the list, sending each byte it touches once - returns the number of bytes sent
+  // with ASYNC_FLUSH this only updates the cache - call flush() or flushAsync() afterwards
+  unsigned int draw (KS0108_display & lcd) const;
+
+  // print the list as the contents of a PROGMEM array, to paste into a sketch
+  // (pictures given to blit are copied in, as LCD_OP_BITMAP)
+  void dump (Print & out) const;
+
+private:
+
+  // a batch of columns of one line, being drawn
+  struct batch
+  {
+    byte page;            // which line
+    int x;                // first column
+    byte count;           // columns in it
+    unsigned long have;   // which columns of bytes [] hold something (bit 0 = column x)
+    boolean peeked;       // something was read from the screen (which moves where we are)
+    byte bytes [32];
+  };
+
+  byte get (const unsigned int i) const { return _buffer ? _list [i] : pgm_read_byte (_list + i); }
+  boolean more (const unsigned int i) const;          // is there an entry at i?
+  const byte * address (const unsigned int i) const;   // of the picture in an LCD_OP_BLIT at i
+  unsigned int next (unsigned int i) const;            // where the entry after the one at i starts
+  boolean add (const byte op, const byte * args, const byte count, const unsigned int extra = 0);
+  boolean span (const KS0108_display & lcd, const unsigned int i, const byte page,
+                int & left, int & right) const;        // columns the entry at i covers on line page
+  void paint (KS0108_display & lcd, const unsigned int i, batch & b) const;
+  static void change (KS0108_display & lcd, batch & b, const int x, const byte mask, const byte bits);
+  static byte rows (const byte page, int from, int to);  // bits of rows from..to (inclusive) in line page
+
+  const byte * _list;     // the entries (in PROGMEM unless recording)
+  byte * _buffer;         // where they are recorded (NULL for a list in PROGMEM)
+  unsigned int _size;     // room in _buffer
+  unsigned int _length;   // bytes recorded
+
+};  // end of class LCD_displayList
+
+#endif  // KS0108_displaylist_H
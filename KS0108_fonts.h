@@ -0,0 +1,216 @@
+/*
+ KS0108_fonts.h
+
+ Fonts whose size is fixed at compile time, for the I2C_graphical_LCD_display library.
+
+ setFont() keeps a font's width, first letter and length in variables, so letter() works them
+ out for every letter. An LCD_font carries them as template arguments instead, so the compiler
+ can fold the range test and table arithmetic into constants for each font:
+
+   #include <cp437_font.h>
+   #include <KS0108_fonts.h>
+
+   const LCD_cp437Font cp437 (cp437_font);
+   ...
+   lcd.string (cp437, "Hello");
+
+ A subset of a font keeps just the letters given, so the rest of the table is left out of
+ the program (the build drops data nothing refers to). The letters must be in ascending order:
+
+   LCD_FONT_SUBSET (digits, cp437_font, 0, false, ' ', '-', '.', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9');
+   ...
+   lcd.string (digits, "-12.5");
+
+ Letters not in a subset are drawn blank. The subset is made by the compiler, from any font
+ table it can see (one in a header, like cp437_font, or in the sketch) - not the built-in font.
+
+ A Unicode font lists the code point of each letter, so it holds just the letters a sketch
+ uses, however far apart they are. Install it with setUnicodeFont() and string() and print()
+ take UTF-8. LCD_UNICODE_FROM_CP437 picks the letters out of cp437_font by code point:
+
+   LCD_UNICODE_FROM_CP437 (symbols, cp437_font, ' ', '%', '.', '0', '1', '2', '3', '4', '5', '6', '7',
+                           '8', '9', 'C', 0xB0, 0x3A9, 0xFFFD);
+   ...
+   lcd.setUnicodeFont (symbols);
+   lcd.print ("25.0°C");
+
+ Any letter not in a Unicode font is drawn as its last letter (a blank for 0xFFFD above, which
+ cp437_font doesn't have).
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#ifndef KS0108_fonts_H
+#define KS0108_fonts_H
+
+#include "I2C_graphical_LCD_display.h"
+
+// a font table in PROGMEM: Length letters of Width bytes each, starting at letter Start,
+// with a one-pixel gap after each letter if Space
+
+template <byte Width, byte Start = 0x20, unsigned int Length = 96, bool Space = true>
+struct LCD_font
+{
+  static const byte width = Width;
+  static const boolean space = Space;
+  static const byte columns = Width + (Space ? 1 : 0);   // across the screen for each letter
+
+  const byte * map;
+
+  constexpr LCD_font (const void * fontMap) : map ((const byte *) fontMap) {}
+
+  static constexpr boolean contains (const byte c) { return c >= Start && (unsigned int) (c - Start) < Length; }
+
+  // the letter's columns in PROGMEM (the last letter in the font for any not there)
+  const byte * glyph (const byte c) const
+    { return map + (contains (c) ? c - Start : Length - 1) * Width; }
+
+};  // end of struct LCD_font
+
+typedef LCD_font <5, 0x20, 96, true> LCD_standardFont;   // KS0108_display::defaultFont ()
+typedef LCD_font <8, 0, 256, false> LCD_cp437Font;       // cp437_font.h
+
+
+// the letters of a subset, made by LCD_FONT_SUBSET - this whole object goes in PROGMEM
+
+template <byte Width> struct LCD_glyph { byte columns [Width]; };
+
+template <byte Width, unsigned int Count, bool Space>
+struct LCD_fontSubset
+{
+  static const byte width = Width;
+  static const boolean space = Space;
+  static const byte columns = Width + (Space ? 1 : 0);
+
+  byte codes [Count];                 // ascending, for a binary search
+  LCD_glyph <Width> glyphs [Count];   // in the same order
+
+  // the letter's columns in PROGMEM (NULL for any not in the subset)
+  const byte * glyph (const byte c) const
+    {
+    unsigned int lo = 0, hi = Count;
+    while (lo < hi)
+      {
+      const unsigned int mid = (lo + hi) / 2;
+      if (pgm_read_byte (&codes [mid]) < c)
+        lo = mid + 1;
+      else
+        hi = mid;
+      }
+    if (lo < Count && pgm_read_byte (&codes [lo]) == c)
+      return glyphs [lo].columns;
+    return NULL;
+    }
+
+};  // end of struct LCD_fontSubset
+
+
+// what LCD_FONT_SUBSET uses to build the subset at compile time
+
+template <unsigned int... I> struct LCD_indexList {};
+template <unsigned int N, unsigned int... I> struct LCD_makeIndexList : LCD_makeIndexList <N - 1, N - 1, I...> {};
+template <unsigned int... I> struct LCD_makeIndexList <0, I...> { typedef LCD_indexList <I...> type; };
+
+template <class T, T... Codes> struct LCD_ascending { static const bool value = true; };
+template <class T, T A, T B, T... Codes> struct LCD_ascending <T, A, B, Codes...>
+  { static const bool value = A < B && LCD_ascending <T, B, Codes...>::value; };
+
+template <byte Start, unsigned int Length, byte... Codes> struct LCD_inFont { static const bool value = true; };
+template <byte Start, unsigned int Length, byte A, byte... Codes> struct LCD_inFont <Start, Length, A, Codes...>
+  { static const bool value = A >= Start && (unsigned int) (A - Start) < Length && LCD_inFont <Start, Length, Codes...>::value; };
+
+template <byte Width, unsigned int Length, const byte (& Source) [Length] [Width], unsigned int... I>
+constexpr LCD_glyph <Width> LCD_copyGlyph (const unsigned int index, LCD_indexList <I...>)
+{
+  return LCD_glyph <Width> { { Source [index] [I]... } };
+}
+
+template <byte Width, unsigned int Length, const byte (& Source) [Length] [Width], byte Start, bool Space, byte... Codes>
+constexpr LCD_fontSubset <Width, sizeof... (Codes), Space> LCD_makeFontSubset ()
+{
+  static_assert (LCD_ascending <byte, Codes...>::value, "LCD_FONT_SUBSET: letters must be in ascending order");
+  static_assert (LCD_inFont <Start, Length, Codes...>::value, "LCD_FONT_SUBSET: letter not in the font");
+  return LCD_fontSubset <Width, sizeof... (Codes), Space>
+    { { Codes... },
+      { LCD_copyGlyph <Width, Length, Source> (Codes - Start, typename LCD_makeIndexList <Width>::type ())... } };
+}
+
+// name: the subset to make;  source: a font table, eg. cp437_font;  start: its first letter;
+// space: a gap after each letter;  then the letters to keep, in ascending order
+#define LCD_FONT_SUBSET(name, source, start, space, ...) \
+  constexpr auto name PROGMEM = \
+    LCD_makeFontSubset <sizeof source [0], sizeof source / sizeof source [0], source, start, space, __VA_ARGS__> ()
+
+
+// a font holding letters for any code points (up to 0xFFFF), for setUnicodeFont -
+// the whole object goes in PROGMEM, and can be written out by hand:
+//
+//   const LCD_unicodeFont <5, 2> arrows PROGMEM = { { 0x2190, 0x2192 },
+//                                                   { { { 0x08, 0x1C, 0x2A, 0x08, 0x08 } },
+//                                                     { { 0x08, 0x08, 0x2A, 0x1C, 0x08 } } } };
+
+template <byte Width, unsigned int Count, bool Space = true>
+struct LCD_unicodeFont
+{
+  static const byte width = Width;
+  static const boolean space = Space;
+  static const unsigned int count = Count;
+
+  uint16_t codes [Count];             // ascending, for a binary search
+  LCD_glyph <Width> glyphs [Count];   // in the same order, the last one for anything not there
+
+};  // end of struct LCD_unicodeFont
+
+
+// the code point for each letter of cp437_font (and the IBM PC character set)
+
+constexpr uint16_t LCD_cp437Unicode [256] = {
+  0x0000, 0x263A, 0x263B, 0x2665, 0x2666, 0x2663, 0x2660, 0x2022, 0x25D8, 0x25CB, 0x25D9, 0x2642, 0x2640, 0x266A, 0x266B, 0x263C,
+  0x25BA, 0x25C4, 0x2195, 0x203C, 0x00B6, 0x00A7, 0x25AC, 0x21A8, 0x2191, 0x2193, 0x2192, 0x2190, 0x221F, 0x2194, 0x25B2, 0x25BC,
+  0x0020, 0x0021, 0x0022, 0x0023, 0x0024, 0x0025, 0x0026, 0x0027, 0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+  0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037, 0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+  0x0040, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+  0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x005B, 0x005C, 0x005D, 0x005E, 0x005F,
+  0x0060, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+  0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x007B, 0x007C, 0x007D, 0x007E, 0x2302,
+  0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7, 0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+  0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9, 0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+  0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA, 0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+  0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556, 0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+  0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F, 0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+  0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B, 0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+  0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4, 0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+  0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248, 0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0 };
+
+// which letter of cp437_font is code point code (256 if none) - ASCII is where it is anyway
+constexpr unsigned int LCD_cp437Find (const uint16_t code, const unsigned int i = 0)
+{
+  return (code >= 0x20 && code < 0x7F) ? code
+         : i >= 256 ? 256
+         : LCD_cp437Unicode [i] == code ? i
+         : LCD_cp437Find (code, i + 1);
+}
+
+// a blank letter, for a code point cp437_font doesn't have
+template <byte Width, unsigned int Length, const byte (& Source) [Length] [Width], unsigned int... I>
+constexpr LCD_glyph <Width> LCD_copyGlyphOrBlank (const unsigned int index, LCD_indexList <I...> indices)
+{
+  return index < Length ? LCD_copyGlyph <Width, Length, Source> (index, indices) : LCD_glyph <Width> { { } };
+}
+
+template <const byte (& Source) [256] [8], uint16_t... Codes>
+constexpr LCD_unicodeFont <8, sizeof... (Codes), false> LCD_makeUnicodeFont ()
+{
+  static_assert (LCD_ascending <uint16_t, Codes...>::value, "LCD_UNICODE_FROM_CP437: code points must be in ascending order");
+  return LCD_unicodeFont <8, sizeof... (Codes), false>
+    { { Codes... },
+      { LCD_copyGlyphOrBlank <8, 256, Source> (LCD_cp437Find (Codes), typename LCD_makeIndexList <8>::type ())... } };
+}
+
+// name: the font to make;  source: cp437_font (or another table in the same order);
+// then the code points to keep, in ascending order - any cp437_font lacks are drawn blank
+#define LCD_UNICODE_FROM_CP437(name, source, ...) \
+  constexpr auto name PROGMEM = LCD_makeUnicodeFont <source, __VA_ARGS__> ()
+
+#endif  // KS0108_fonts_H
@@ -0,0 +1,605 @@
+/*
+ KS0108_transport.cpp
+
+ Bus-level code for the KS0108 driver: 74HC595 (2-wire), MCP23017 (I2C) and MCP23S17 (SPI).
+
+ SEE I2C_graphical_LCD_display.h FOR HARDWARE CONNECTIONS AND LICENSE
+
+ */
+
+#include "I2C_graphical_LCD_display.h"
+
+// KS0108 status byte (read with D/I low)
+#define LCD_STATUS_BUSY 0x80
+
+// how many times to poll the status byte before giving up (LCD_BUSY_POLL only)
+#define LCD_BUSY_POLL_LIMIT 20
+
+// send a run of data bytes one at a time - transports override this if they can do better
+void KS0108_transport::writeDataRun (const byte chipSelect,
+                                     const byte * data,
+                                     byte count,
+                                     const byte stride)
+{
+  for ( ; count; count--, data += stride)
+    writeData (chipSelect, *data);
+}  // end of KS0108_transport::writeDataRun
+
+
+// ---------------------------------------------------------------------------
+//  74HC595 (2-wire)
+// ---------------------------------------------------------------------------
+
+// Port manipulation macros for 2-wire interface
+#if defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
+#define clkpulse() {*_clkPort |= _clkMask; *_clkPort ^= _clkMask;}
+#define setdata(v) {if(v) *_dataPort |= _dataMask; else *_dataPort &= ~_dataMask;}
+#elif defined(digitalWriteFast)
+#define clkpulse() {digitalWriteFast(_clkPin, HIGH); digitalWriteFast(_clkPin, LOW);}
+#define setdata(v) {digitalWriteFast(_dataPin, v);}
+#elif defined(ARDUINO_ARCH_ESP8266)
+#define clkpulse() {GPOS = _clkMask; GPOC = _clkMask;}
+#define setdata(v) {if(v) GPOS = _dataMask; else GPOC = _dataMask;}
+#else
+#define clkpulse() {digitalWrite(_clkPin, HIGH); digitalWrite(_clkPin, LOW);}
+#define setdata(v) {digitalWrite(_dataPin, v);}
+#endif
+
+#define sendbit(v) {setdata(v); clkpulse();}
+
+// and for the LATCH pin with HC595_SPI_LATCH
+#if defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
+#define latchpulse() {*_latchPort |= _latchMask; *_latchPort ^= _latchMask;}
+#elif defined(digitalWriteFast)
+#define latchpulse() {digitalWriteFast(_latchPin, HIGH); digitalWriteFast(_latchPin, LOW);}
+#elif defined(ARDUINO_ARCH_ESP8266)
+#define latchpulse() {GPOS = _latchMask; GPOC = _latchMask;}
+#else
+#define latchpulse() {digitalWrite(_latchPin, HIGH); digitalWrite(_latchPin, LOW);}
+#endif
+
+#if defined(HC595_HWSPI)
+// reverse the order of the bits in a byte
+static inline byte reverseBits (byte b)
+{
+  b = (b >> 4) | (b << 4);
+  b = ((b & 0xCC) >> 2) | ((b & 0x33) << 2);
+  b = ((b & 0xAA) >> 1) | ((b & 0x55) << 1);
+  return b;
+}
+
+// Send command or data on the 74HC595 interface, using hardware SPI
+// This is the same 16 bits as the bit-banged version below, sent MSB first, so bit n of
+// the frame lands on output n of the chain (IC1 QA = bit 0 ... IC2 QH = bit 15):
+//   bit 15 leading 1 (reaches IC2 QH* last, enabling the diode latch), 14 CS4, 13 CS3,
+//   12 enable, 11 rs, 10..3 data bits 0..7, 2 CS1, 1 CS2, 0 trailing 1 (drives DATA high to latch)
+void KS0108_2wire::do2wireSend(const byte rs, const byte data, const byte enable, const byte chipSelect)
+{
+	unsigned int frame = 0x8001 | ((unsigned int) reverseBits (data) << 3);
+	if (enable)
+		frame |= 0x1000;
+	if (rs)
+		frame |= 0x0800;
+	if (chipSelect & LCD_CS1)
+		frame |= 0x0004;
+	if (chipSelect & LCD_CS2)
+		frame |= 0x0002;
+	if (chipSelect & LCD_CS3)
+		frame |= 0x2000;
+	if (chipSelect & LCD_CS4)
+		frame |= 0x4000;
+
+	SPI.beginTransaction (_spiSettings);
+	SPI.transfer16 (frame);
+#if defined(HC595_SPI_LATCH)
+	latchpulse ();
+#else
+	// on the 16th clock the leading 1 reaches QH* while MOSI is still high from the
+	// trailing 1, so the latch fires exactly as with the bit-banged version -
+	// now clock zeros through to clear the shifter (and take the latch low again)
+	SPI.transfer16 (0);
+#endif
+	SPI.endTransaction ();
+}
+#else
+void KS0108_2wire::do2wireSend(const byte rs, const byte data, const byte enable, const byte chipSelect)
+{
+	sendbit(1);		// Leading 1 to eventually enable latch
+	sendbit((chipSelect & LCD_CS4) != 0);	// (IC2 QG - no connection on 2-chip panels)
+	sendbit((chipSelect & LCD_CS3) != 0);	// (IC2 QF - no connection on 2-chip panels)
+	sendbit(enable);	// LCD enable
+	sendbit(rs);	// rs is 0 for command, 1 for data
+	byte t = data;
+	for(char i = 0; i < 8; ++i)	 // send data byte one bit at a time, LSB first
+	{
+		sendbit(t & 0x01);
+		t >>= 1;
+	}
+	sendbit((chipSelect & LCD_CS1) != 0);
+	sendbit((chipSelect & LCD_CS2) != 0);
+	sendbit(1);			// Latch new data
+	sendbit(0);
+//	for(int i = 0; i < 15; ++i)
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+	clkpulse();		// Clear the shifter
+}
+#endif
+
+// set up the pins (or SPI) and clear the shift registers
+void KS0108_2wire::begin (const LCD_timing & timing)
+{
+  _enableWidth = timing.enableWidth;
+
+#if defined(HC595_HWSPI)
+		_spiSettings = SPISettings (timing.spiClock, MSBFIRST, SPI_MODE0);
+		SPI.begin ();
+#if defined(HC595_SPI_LATCH)
+#if defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
+		_latchPort = portOutputRegister(digitalPinToPort(_latchPin));
+		_latchMask = digitalPinToBitMask(_latchPin);
+#endif
+#if defined(ARDUINO_ARCH_ESP8266)
+		_latchMask = 1<<_latchPin;
+#endif
+		pinMode(_latchPin, OUTPUT);
+		digitalWrite(_latchPin, LOW);
+#endif
+#else
+#if defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
+		_clkPort = portOutputRegister(digitalPinToPort(_clkPin));
+		_dataPort = portOutputRegister(digitalPinToPort(_dataPin));
+		_clkMask = digitalPinToBitMask(_clkPin);
+		_dataMask = digitalPinToBitMask(_dataPin);
+#endif
+#if defined(ARDUINO_ARCH_ESP8266)
+		_clkMask = 1<<_clkPin;
+		_dataMask = 1<<_dataPin;
+#endif
+		pinMode(_clkPin, OUTPUT);
+		pinMode(_dataPin, OUTPUT);
+		digitalWrite(_clkPin, LOW);
+#endif
+		do2wireSend(0, 0, 0, 0);			// clear the shifter and latch
+}  // end of KS0108_2wire::begin
+
+// send command to LCD display
+void KS0108_2wire::writeCommand (const byte chipSelect, const byte data)
+{
+		do2wireSend(0, data, 1, chipSelect);		// rs is 0 meaning instruction, raise enable
+		if (_enableWidth)
+			delayMicroseconds (_enableWidth);
+		do2wireSend(0, data, 0, chipSelect);		// now drop enable
+}  // end of KS0108_2wire::writeCommand
+
+// send screen data to LCD display
+void KS0108_2wire::writeData (const byte chipSelect, const byte data)
+{
+		do2wireSend(1, data, 1, chipSelect);		// rs is 1 to indicate data, raise enable
+		if (_enableWidth)
+			delayMicroseconds (_enableWidth);
+		do2wireSend(1, data, 0, chipSelect);		// now drop enable
+}  // end of KS0108_2wire::writeData
+
+
+#if defined(MCP23x17)
+
+// ---------------------------------------------------------------------------
+//  MCP23017 / MCP23S17 common code
+// ---------------------------------------------------------------------------
+
+// set up the expander and reset the LCD (the bus itself is set up by the derived class)
+void KS0108_MCP23x17::begin (const LCD_timing & timing)
+{
+		_enableWidth = timing.enableWidth;
+
+		// byte mode (not sequential)
+		expanderWrite (IOCON, 0b00100000);
+
+		// all pins as outputs
+		expanderWrite (IODIRA, 0);
+		expanderWrite (IODIRB, 0);
+
+		// take reset line low
+		startSend ();
+			doSend (GPIOA);
+			doSend (0); // all lines low
+		endSend ();
+
+		// now raise reset (and enable) line and wait briefly
+		expanderWrite (GPIOA, LCD_ENABLE | LCD_RESET);
+}  // end of KS0108_MCP23x17::begin
+
+// set register "reg" on expander to "data"
+// for example, IO direction
+void KS0108_MCP23x17::expanderWrite (const byte reg,
+                                     const byte data )
+{
+  startSend ();
+    doSend (reg);
+    doSend (data);
+  endSend ();
+} // end of KS0108_MCP23x17::expanderWrite
+
+// send command to LCD display
+// for example, setting page (Y) or address (X)
+void KS0108_MCP23x17::writeCommand (const byte chipSelect, const byte data)
+{
+  waitReady (chipSelect);
+  startSend ();
+    doSend (GPIOA);                      // control port
+    doSend (LCD_RESET | LCD_ENABLE | chipSelect);   // set enable high (D/I is low meaning instruction)
+    doSend (data);                       // (command written to GPIOB)
+    if (_enableWidth)                    // (only useful for SPI - I2C is buffered, and slow enough anyway)
+      delayMicroseconds (_enableWidth);
+    doSend (LCD_RESET | chipSelect);     // (GPIOA again) pull enable low to toggle data
+  endSend ();
+} // end of KS0108_MCP23x17::writeCommand
+
+// send screen data to LCD display
+void KS0108_MCP23x17::writeData (const byte chipSelect, const byte data)
+{
+	// note that the MCP23x17 automatically toggles between port A and port B
+  // so the four sends do this:
+  //   1. Choose initial port as GPIOA (general IO port A)
+  //   2. Port A: set E high
+  //   3. Port B: send the data byte
+  //   4. Port A: set E low to toggle the transfer of data
+
+  waitReady (chipSelect);
+  startSend ();
+    doSend (GPIOA);                  // control port
+    doSend (LCD_RESET | LCD_DATA | LCD_ENABLE | chipSelect);  // set enable high
+    doSend (data);                   // (screen data written to GPIOB)
+    if (_enableWidth)
+      delayMicroseconds (_enableWidth);
+    doSend (LCD_RESET | LCD_DATA | chipSelect);  // (GPIOA again) pull enable low to toggle data
+  endSend ();
+}  // end of KS0108_MCP23x17::writeData
+
+// send a run of screen data in as few transactions as possible
+// after the first byte, the toggling between ports continues:
+//   Port B: next data byte, Port A: set E high, Port B: same byte again, Port A: set E low
+// which is 4 bytes per data byte instead of a whole new transaction each
+void KS0108_MCP23x17::writeDataRun (const byte chipSelect,
+                                    const byte * data,
+                                    byte count,
+                                    const byte stride)
+{
+  const byte most = maxRun ();
+
+  while (count)
+    {
+    byte n = count < most ? count : most;
+    count -= n;
+
+    waitReady (chipSelect);
+    startSend ();
+      doSend (GPIOA);                  // control port
+      doSend (LCD_RESET | LCD_DATA | LCD_ENABLE | chipSelect);  // set enable high
+      doSend (*data);                  // (screen data written to GPIOB)
+      if (_enableWidth)
+        delayMicroseconds (_enableWidth);
+      doSend (LCD_RESET | LCD_DATA | chipSelect);  // (GPIOA again) pull enable low to toggle data
+      data += stride;
+
+      while (--n)
+        {
+        paceRun ();
+        doSend (*data);                // (GPIOB) set up the next byte
+        doSend (LCD_RESET | LCD_DATA | LCD_ENABLE | chipSelect);  // (GPIOA) set enable high
+        doSend (*data);                // (GPIOB) unchanged - just gets us back to GPIOA
+        if (_enableWidth)
+          delayMicroseconds (_enableWidth);
+        doSend (LCD_RESET | LCD_DATA | chipSelect);  // (GPIOA) pull enable low to toggle data
+        data += stride;
+        }
+    endSend ();
+    }
+}  // end of KS0108_MCP23x17::writeDataRun
+
+// read the byte at the LCD's current address
+byte KS0108_MCP23x17::readData (const byte chipSelect)
+{
+  waitReady (chipSelect);
+
+  // data port (on the MCP23017) is now input
+  expanderWrite (IODIRB, 0xFF);
+
+  // lol, see the KS0108 spec sheet - you need to read twice to get the data
+  startSend ();
+    doSend (GPIOA);                  // control port
+    doSend (LCD_RESET | LCD_READ | LCD_DATA | LCD_ENABLE | chipSelect);  // set enable high
+  endSend ();
+
+  startSend ();
+    doSend (GPIOA);                  // control port
+    doSend (LCD_RESET | LCD_READ | LCD_DATA | chipSelect);  // pull enable low to toggle data
+  endSend ();
+
+  startSend ();
+  doSend (GPIOA);                  // control port
+  doSend (LCD_RESET | LCD_READ | LCD_DATA | LCD_ENABLE | chipSelect);  // set enable high
+  endSend ();
+
+  byte data = readPortB ();
+
+  // drop enable AFTER we have read it
+  startSend ();
+  doSend (GPIOA);                  // control port
+  doSend (LCD_RESET | LCD_READ | LCD_DATA | chipSelect);  // pull enable low to toggle data
+  endSend ();
+
+  // data port (on the MCP23017) is now output again
+  expanderWrite (IODIRB, 0);
+
+  return data;
+}  // end of KS0108_MCP23x17::readData
+
+// read the status byte of the selected chip (busy flag is bit 7)
+byte KS0108_MCP23x17::readStatus (const byte chipSelect)
+{
+  byte data;
+
+  // data port (on the MCP23017) is now input
+  expanderWrite (IODIRB, 0xFF);
+
+  startSend ();
+    doSend (GPIOA);                  // control port
+    doSend (LCD_RESET | LCD_READ | LCD_ENABLE | chipSelect);  // set enable high (D/I is low meaning status)
+  endSend ();
+
+  data = readPortB ();
+
+  startSend ();
+    doSend (GPIOA);                  // control port
+    doSend (LCD_RESET | LCD_READ | chipSelect);  // pull enable low again
+  endSend ();
+
+  // data port (on the MCP23017) is now output again
+  expanderWrite (IODIRB, 0);
+
+  return data;
+}  // end of KS0108_MCP23x17::readStatus
+
+#endif  // MCP23x17
+
+
+#if defined(MCP23017)
+
+// ---------------------------------------------------------------------------
+//  MCP23017 (I2C)
+// ---------------------------------------------------------------------------
+
+// glue routines for version 1.0+ of the IDE
+static uint8_t i2c_read ()
+{
+#if defined(ARDUINO) && ARDUINO >= 100
+  return Wire.read ();
+#else
+  return Wire.receive ();
+#endif
+} // end of Nunchuk::i2c_read
+
+static void i2c_write (int data)
+{
+#if defined(ARDUINO) && ARDUINO >= 100
+  Wire.write (data);
+#else
+  Wire.send (data);
+#endif
+} // end of Nunchuk::i2c_write
+
+void KS0108_MCP23017::begin (const LCD_timing & timing)
+{
+  Wire.begin (_i2cAddress);
+
+  // for faster I2C communications, use a timing.i2cClock of 400000 or more
+  setBusClock (timing.i2cClock);
+
+  KS0108_MCP23x17::begin (timing);
+}  // end of KS0108_MCP23017::begin
+
+// the fastest I2C clock Wire can set: on AVR it uses TWBR = (F_CPU / hz - 16) / 2, so
+// anything faster than F_CPU / 16 wraps round to a very slow clock (about 31 kHz at 16 MHz)
+#if defined(__AVR__)
+#define I2C_MAX_CLOCK (F_CPU / 16)
+#endif
+
+// change the I2C clock (Hz), 0 leaves it alone
+void KS0108_MCP23017::setBusClock (const unsigned long hz)
+{
+  if (!hz)
+    return;
+#if defined(I2C_MAX_CLOCK)
+  Wire.setClock (hz > I2C_MAX_CLOCK ? I2C_MAX_CLOCK : hz);
+#else
+  Wire.setClock (hz);
+#endif
+}  // end of KS0108_MCP23017::setBusClock
+
+// standard I2C clocks, leaving out any this board can't set
+// (a clock that wrapped round would still pass the test pattern, so tuneBusClock() would
+// report it while the bus ran slower than 100 kHz)
+byte KS0108_MCP23017::busClocks (const unsigned long * & clocks)
+{
+  static const unsigned long i2cClocks [] = { 100000, 400000, 1000000, 1700000 };
+  byte count = sizeof i2cClocks / sizeof i2cClocks [0];
+#if defined(I2C_MAX_CLOCK)
+  while (count && i2cClocks [count - 1] > I2C_MAX_CLOCK)
+    count--;
+#endif
+  clocks = i2cClocks;
+  return count;
+}  // end of KS0108_MCP23017::busClocks
+
+// prepare for sending to MCP23017
+void KS0108_MCP23017::startSend ()
+{
+  Wire.beginTransmission (_port);
+}  // end of KS0108_MCP23017::startSend
+
+// send a byte via I2C
+void KS0108_MCP23017::doSend (const byte what)
+{
+  i2c_write (what);
+}  // end of KS0108_MCP23017::doSend
+
+// finish sending to MCP23017
+void KS0108_MCP23017::endSend ()
+{
+  // not acknowledged (eg. noise on the bus)? count it
+  if (Wire.endTransmission () != 0)
+    _busErrors++;
+}  // end of KS0108_MCP23017::endSend
+
+// read the data port (GPIOB) on the expander, eg. while the LCD is driving it
+// this relies on the last write having been to GPIOA: in byte mode the
+// MCP23017 then toggles its register pointer over to GPIOB for us
+byte KS0108_MCP23017::readPortB ()
+{
+  // initiate blocking read into internal buffer
+  if (Wire.requestFrom (_port, (byte) 1) != 1)
+    _busErrors++;
+
+  // don't bother checking if available, Wire.receive does that anyway
+  //  also it returns 0x00 if nothing there, so we don't need to bother doing that
+  return i2c_read ();
+}  // end of KS0108_MCP23017::readPortB
+
+// Wire buffers a whole transmission (32 bytes on AVR): register + 3 bytes for
+// the first data byte, then 4 for each one after that
+byte KS0108_MCP23017::maxRun ()
+{
+  return 8;
+}  // end of KS0108_MCP23017::maxRun
+
+#endif  // MCP23017
+
+
+#if defined(MCP23S17)
+
+// ---------------------------------------------------------------------------
+//  MCP23S17 (SPI)
+// ---------------------------------------------------------------------------
+
+void KS0108_MCP23S17::begin (const LCD_timing & timing)
+{
+  _busyDelay = timing.busyDelay;
+  _spiMode = timing.spiMode;
+
+  pinMode (_ssPin, OUTPUT);
+  digitalWrite (_ssPin, HIGH);
+  SPI.begin ();
+  setBusClock (timing.spiClock);
+
+  KS0108_MCP23x17::begin (timing);
+}  // end of KS0108_MCP23S17::begin
+
+// change the SPI clock (Hz)
+// (SPISettings wants the SPI_MODEn constants, which aren't 0 to 3 on every board - on AVR they are
+// the bits for SPCR)
+void KS0108_MCP23S17::setBusClock (const unsigned long hz)
+{
+  static const byte spiModes [4] = { SPI_MODE0, SPI_MODE1, SPI_MODE2, SPI_MODE3 };
+  _spiSettings = SPISettings (hz, MSBFIRST, spiModes [_spiMode & 3]);
+}  // end of KS0108_MCP23S17::setBusClock
+
+// SPI clocks to try (the MCP23S17 is rated to 10 MHz)
+byte KS0108_MCP23S17::busClocks (const unsigned long * & clocks)
+{
+  static const unsigned long spiClocks [] = { 1000000, 2000000, 4000000, 8000000, 10000000 };
+  clocks = spiClocks;
+  return sizeof spiClocks / sizeof spiClocks [0];
+}  // end of KS0108_MCP23S17::busClocks
+
+// prepare for sending to MCP23S17
+void KS0108_MCP23S17::startSend ()
+{
+  SPI.beginTransaction (_spiSettings);
+  digitalWrite (_ssPin, LOW);
+  SPI.transfer (_port << 1);
+}  // end of KS0108_MCP23S17::startSend
+
+// send a byte via SPI
+void KS0108_MCP23S17::doSend (const byte what)
+{
+  SPI.transfer (what);
+}  // end of KS0108_MCP23S17::doSend
+
+// finish sending to MCP23S17
+void KS0108_MCP23S17::endSend ()
+{
+  digitalWrite (_ssPin, HIGH);
+  SPI.endTransaction ();
+  _lastEnable = micros ();
+}  // end of KS0108_MCP23S17::endSend
+
+// read the data port (GPIOB) on the expander, eg. while the LCD is driving it
+byte KS0108_MCP23S17::readPortB ()
+{
+  byte data;
+
+  SPI.beginTransaction (_spiSettings);
+  digitalWrite (_ssPin, LOW);
+  SPI.transfer ((_port << 1) | 1);  // read operation has low-bit set
+  SPI.transfer (GPIOB);             // which register to read from
+  data = SPI.transfer (0);          // get byte back
+  digitalWrite (_ssPin, HIGH);
+  SPI.endTransaction ();
+
+  return data;
+}  // end of KS0108_MCP23S17::readPortB
+
+// SPI is so fast we need to give the LCD time to catch up
+// wait until the LCD can accept another operation
+// the delay is counted from the end of the previous transaction, so time
+// spent elsewhere (eg. working out what to draw next) is not wasted
+void KS0108_MCP23S17::waitReady (const byte chipSelect)
+{
+  const unsigned long start = _lastEnable;
+
+#if defined(LCD_BUSY_POLL)
+  // ask the LCD itself, unless enough time has already gone by
+  for (byte i = 0; i < LCD_BUSY_POLL_LIMIT; i++)
+    {
+    if ((micros () - start) >= _busyDelay)
+      break;
+    if ((readStatus (chipSelect) & LCD_STATUS_BUSY) == 0)
+      break;
+    }
+#else
+  while ((micros () - start) < _busyDelay)
+    { }
+#endif
+}  // end of KS0108_MCP23S17::waitReady
+
+// wait between the bytes of a run - we are inside a transaction, so can't poll
+void KS0108_MCP23S17::paceRun ()
+{
+  if (_busyDelay)
+    delayMicroseconds (_busyDelay);
+}  // end of KS0108_MCP23S17::paceRun
+
+#if defined(LCD_BUSY_POLL)
+// a transaction for each byte of a run, so waitReady can poll the busy flag before it
+// (one more SPI byte each than carrying on in the same transaction, but no fixed delay)
+byte KS0108_MCP23S17::maxRun ()
+{
+  return 1;
+}  // end of KS0108_MCP23S17::maxRun
+#endif
+
+#endif  // MCP23S17
@@ -0,0 +1,233 @@
+/*
+ KS0108_transport.h
+
+ Interfaces between the KS0108 driver (I2C_graphical_LCD_display) and the hardware.
+
+ The driver only knows how to ask for commands and data to be sent to one or more of
+ the LCD controller chips; a transport turns that into traffic on the bus it uses.
+ Each display object talks through one transport, so displays on different interfaces
+ can be used from the same sketch, and a transport can send a run of bytes in whatever
+ way is fastest for its bus.
+
+ Transports supplied:
+
+   KS0108_2wire     - dual 74HC595 board (bit-banged, or hardware SPI with HC595_SPI / HC595_SPI_LATCH)
+   KS0108_MCP23017  - MCP23017 I2C port expander  (compiled if MCP23017 is defined)
+   KS0108_MCP23S17  - MCP23S17 SPI port expander  (compiled if MCP23S17 is defined)
+
+ To add another, derive from KS0108_transport and implement at least begin(),
+ writeCommand() and writeData().
+
+ This file is included by I2C_graphical_LCD_display.h, which holds the configuration
+ defines and pin assignments. See there for hardware connections and license.
+
+ */
+
+#ifndef KS0108_transport_H
+#define KS0108_transport_H
+
+class KS0108_transport
+{
+public:
+
+  // set up the bus and reset the LCD
+  virtual void begin (const LCD_timing & timing) = 0;
+
+  // send an instruction to the chip(s) selected (LCD_CS1, LCD_CS2 ...)
+  virtual void writeCommand (const byte chipSelect, const byte data) = 0;
+
+  // send one byte of screen data - the LCD then moves its address one column right
+  virtual void writeData (const byte chipSelect, const byte data) = 0;
+
+  // send count bytes of screen data, taking every stride'th byte from data
+  // (stride 0 sends data [0] count times) - override if the bus can do a run faster
+  virtual void writeDataRun (const byte chipSelect,
+                             const byte * data,
+                             byte count,
+                             const byte stride = 1);
+
+  // can the LCD be read back through this transport?
+  virtual boolean canRead () { return false; }
+
+  // read the byte at the current address (the address then moves one column right)
+  virtual byte readData (const byte chipSelect) { return 0; }
+
+  // read the status byte (busy flag is bit 7)
+  virtual byte readStatus (const byte chipSelect) { return 0; }
+
+  // bus speed control, used by tuneBusClock() and calibrateBusyDelay()
+  virtual void setBusClock (const unsigned long hz) { }
+  virtual byte busClocks (const unsigned long * & clocks) { return 0; }  // standard clocks, slowest first
+  virtual void setBusyDelay (const byte us) { }
+  virtual byte getBusyDelay () { return 0; }
+
+  // transfers the bus reported as failed so far (eg. not acknowledged on I2C)
+  virtual unsigned int busErrors () { return 0; }
+
+};  // end of class KS0108_transport
+
+
+// dual 74HC595 shift register board
+
+class KS0108_2wire : public KS0108_transport
+{
+public:
+
+  // with HC595_SPI / HC595_SPI_LATCH, clkPin and dataPin are ignored (the SPI pins are used)
+  KS0108_2wire (const byte clkPin, const byte dataPin, const byte latchPin = 0) :
+                _enableWidth (0), _clkPin (clkPin), _dataPin (dataPin), _latchPin (latchPin) {}
+
+  virtual void begin (const LCD_timing & timing);
+  virtual void writeCommand (const byte chipSelect, const byte data);
+  virtual void writeData (const byte chipSelect, const byte data);
+
+private:
+
+  void do2wireSend (const byte rs, const byte data, const byte enable, const byte chipSelect);		// Send command or data on 2-wire interface
+
+  byte _enableWidth;    // extra microseconds to hold enable high
+
+#if defined(HC595_HWSPI)
+  SPISettings _spiSettings;   // SPI clock, bit order and mode
+#endif
+
+  byte _clkPin;		// pin for 2-wire CLK
+  byte _dataPin;	// pin for 2-wire DATA
+  byte _latchPin;	// pin for LATCH (HC595_SPI_LATCH only)
+#if defined(__AVR__)
+  volatile byte * _clkPort;	// CLK port
+  byte _clkMask;	// CLK bitmask
+  volatile byte * _dataPort;	// DATA port
+  byte _dataMask;	// DATA bitmask
+  volatile byte * _latchPort;	// LATCH port
+  byte _latchMask;	// LATCH bitmask
+#elif defined(ARDUINO_ARCH_SAMD)
+	volatile uint32_t * _clkPort;
+	uint32_t _clkMask;
+	volatile uint32_t * _dataPort;
+	uint32_t _dataMask;
+	volatile uint32_t * _latchPort;
+	uint32_t _latchMask;
+#elif defined(ARDUINO_ARCH_ESP8266)
+	uint16_t _clkMask;
+	uint16_t _dataMask;
+	uint16_t _latchMask;
+#endif
+
+};  // end of class KS0108_2wire
+
+
+#if defined(MCP23x17)
+
+// what the MCP23017 and MCP23S17 have in common - everything except the bus
+
+class KS0108_MCP23x17 : public KS0108_transport
+{
+public:
+
+  KS0108_MCP23x17 (const byte port) : _port (port), _enableWidth (0) {}
+
+  virtual void begin (const LCD_timing & timing);
+  virtual void writeCommand (const byte chipSelect, const byte data);
+  virtual void writeData (const byte chipSelect, const byte data);
+  virtual void writeDataRun (const byte chipSelect,
+                             const byte * data,
+                             byte count,
+                             const byte stride = 1);
+  virtual boolean canRead () { return true; }
+  virtual byte readData (const byte chipSelect);
+  virtual byte readStatus (const byte chipSelect);
+
+protected:
+
+  virtual void startSend () = 0;    // prepare for sending to MCP23017  (eg. set SS low)
+  virtual void doSend (const byte what) = 0;  // send a byte to the MCP23017
+  virtual void endSend () = 0;      // finished sending  (eg. set SS high)
+  virtual byte readPortB () = 0;    // read the data port on the MCP23017
+  virtual void waitReady (const byte chipSelect) { }  // wait until the LCD is ready for another operation
+  virtual void paceRun () { }       // wait between bytes of a run (inside one transaction)
+  virtual byte maxRun () { return 255; }  // most bytes of a run to send in one transaction
+
+  void expanderWrite (const byte reg, const byte data);
+
+  byte _port;           // port that the MCP23017 is on (should be 0x20 to 0x27)
+  byte _enableWidth;    // extra microseconds to hold enable high (SPI only)
+
+};  // end of class KS0108_MCP23x17
+
+#endif  // MCP23x17
+
+
+#if defined(MCP23017)
+
+// MCP23017 on I2C
+
+class KS0108_MCP23017 : public KS0108_MCP23x17
+{
+public:
+
+  KS0108_MCP23017 (const byte port = 0x20, const byte i2cAddress = 0) :
+                   KS0108_MCP23x17 (port), _i2cAddress (i2cAddress), _busErrors (0) {}
+
+  virtual void begin (const LCD_timing & timing);
+  virtual void setBusClock (const unsigned long hz);
+  virtual byte busClocks (const unsigned long * & clocks);
+  virtual unsigned int busErrors () { return _busErrors; }
+
+protected:
+
+  virtual void startSend ();
+  virtual void doSend (const byte what);
+  virtual void endSend ();
+  virtual byte readPortB ();
+  virtual byte maxRun ();
+
+  byte _i2cAddress;     // our own I2C address (0 = master)
+  unsigned int _busErrors;  // transmissions not acknowledged, or reads that came back short
+
+};  // end of class KS0108_MCP23017
+
+#endif  // MCP23017
+
+
+#if defined(MCP23S17)
+
+// MCP23S17 on SPI
+
+class KS0108_MCP23S17 : public KS0108_MCP23x17
+{
+public:
+
+  KS0108_MCP23S17 (const byte ssPin = 10, const byte port = 0x20) :
+                   KS0108_MCP23x17 (port), _ssPin (ssPin), _spiMode (0),
+                   _busyDelay (LCD_BUSY_DELAY), _lastEnable (0) {}
+
+  virtual void begin (const LCD_timing & timing);
+  virtual void setBusClock (const unsigned long hz);
+  virtual byte busClocks (const unsigned long * & clocks);
+  virtual void setBusyDelay (const byte us) { _busyDelay = us; }
+  virtual byte getBusyDelay () { return _busyDelay; }
+
+protected:
+
+  virtual void startSend ();
+  virtual void doSend (const byte what);
+  virtual void endSend ();
+  virtual byte readPortB ();
+  virtual void waitReady (const byte chipSelect);
+  virtual void paceRun ();
+#if defined(LCD_BUSY_POLL)
+  virtual byte maxRun ();
+#endif
+
+  byte _ssPin;          // SPI slave select pin
+  byte _spiMode;        // SPI mode (0 to 3)
+  SPISettings _spiSettings;   // SPI clock, bit order and mode
+  byte _busyDelay;      // microseconds between LCD operations
+  unsigned long _lastEnable;  // micros() when the last LCD operation finished
+
+};  // end of class KS0108_MCP23S17
+
+#endif  // MCP23S17
+
+#endif  // KS0108_transport_H
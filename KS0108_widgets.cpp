@@ -0,0 +1,390 @@
+/*
+ KS0108_widgets.cpp
+
+ Retained-mode widgets for the I2C_graphical_LCD_display library - see KS0108_widgets.h
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#include "KS0108_widgets.h"
+
+// ---------------------------------------------------------------------------
+//  LCD_widget
+// ---------------------------------------------------------------------------
+
+// the bits in line page (counted from the widget's top) for rows from..to (inclusive, counted
+// from the widget's top), leaving out anything below the widget
+byte LCD_widget::rowBits (const byte page,
+                          int from,
+                          int to) const
+{
+  if (to > _h - 1)
+    to = _h - 1;
+
+  // make them relative to this line
+  from -= page << 3;
+  to -= page << 3;
+  if (from < 0)
+    from = 0;
+  if (to > 7)
+    to = 7;
+  if (from > to)
+    return 0;
+
+  return (0xFF << from) & (0xFF >> (7 - to));
+}  // end of LCD_widget::rowBits
+
+// mark part of the widget as needing redrawing - added to anything already marked
+void LCD_widget::invalidate (const byte x1,
+                             const byte x2,
+                             const byte page1,
+                             const byte page2)
+{
+  if (!_dirty)
+    {
+    _dirtyX1 = x1;
+    _dirtyX2 = x2;
+    _dirtyPage1 = page1;
+    _dirtyPage2 = page2;
+    _dirty = true;
+    return;
+    }
+
+  if (x1 < _dirtyX1)
+    _dirtyX1 = x1;
+  if (x2 > _dirtyX2)
+    _dirtyX2 = x2;
+  if (page1 < _dirtyPage1)
+    _dirtyPage1 = page1;
+  if (page2 > _dirtyPage2)
+    _dirtyPage2 = page2;
+}  // end of LCD_widget::invalidate
+
+
+// ---------------------------------------------------------------------------
+//  LCD_label
+// ---------------------------------------------------------------------------
+
+// a quick hash of a string, so changes can be spotted without keeping a copy
+unsigned int LCD_label::hash (const char * s)
+{
+  unsigned int h = 5381;
+  while (*s)
+    h = (h << 5) + h + *s++;
+  return h;
+}  // end of LCD_label::hash
+
+void LCD_label::setText (const char * text)
+{
+  const unsigned int h = hash (text);
+  if (text == _text && h == _hash)
+    return;   // same as before
+
+  _text = text;
+  _hash = h;
+  invalidate ();
+}  // end of LCD_label::setText
+
+byte LCD_label::column (const KS0108_display & lcd,
+                        const byte x,
+                        const byte page)
+{
+  // find the letter this column is part of
+  const byte glyphWidth = lcd.glyphWidth ();
+  const char * p = _text;
+  for (byte i = x / glyphWidth; i && *p; i--)
+    p++;
+
+  const byte bits = *p ? lcd.glyphColumn (*p, x % glyphWidth) : 0;
+  return _inv ? ~bits : bits;
+}  // end of LCD_label::column
+
+
+// ---------------------------------------------------------------------------
+//  LCD_value
+// ---------------------------------------------------------------------------
+
+void LCD_value::setValue (const long value)
+{
+  if (value == _value)
+    return;   // same as before
+
+  char old [sizeof _buf];
+  memcpy (old, _buf, sizeof old);
+
+  _value = value;
+  format ();
+
+  // redraw from the first letter that changed to the last
+  byte first = 0xFF, last = 0;
+  for (byte i = 0; i < _digits; i++)
+    if (_buf [i] != old [i])
+      {
+      if (first == 0xFF)
+        first = i;
+      last = i;
+      }
+
+  if (first != 0xFF)
+    invalidate (first * _charWidth, (last + 1) * _charWidth - 1, 0, 0);
+}  // end of LCD_value::setValue
+
+// put the value into _buf, padded with spaces to the width of the field
+void LCD_value::format ()
+{
+  char digits [14];
+  char * p = &digits [sizeof digits - 1];
+  *p = 0;
+
+  unsigned long n = _value < 0 ? - (unsigned long) _value : _value;
+  byte count = 0;
+  do
+    {
+    if (_decimals && count == _decimals)
+      *--p = '.';
+    *--p = '0' + n % 10;
+    n /= 10;
+    count++;
+    } while (n || count <= _decimals);   // (always a digit before the point)
+  if (_value < 0)
+    *--p = '-';
+
+  const byte length = &digits [sizeof digits - 1] - p;
+  byte i = 0;
+  if (length > _digits)
+    {
+    while (i < _digits)
+      _buf [i++] = '*';
+    }
+  else
+    {
+    if (_align == LCD_ALIGN_RIGHT)
+      while (i < _digits - length)
+        _buf [i++] = ' ';
+    while (*p)
+      _buf [i++] = *p++;
+    while (i < _digits)
+      _buf [i++] = ' ';
+    }
+  _buf [i] = 0;
+
+  _hash = hash (_buf);
+}  // end of LCD_value::format
+
+
+// ---------------------------------------------------------------------------
+//  LCD_bar
+// ---------------------------------------------------------------------------
+
+void LCD_bar::setValue (const int value)
+{
+  // how many columns (or rows) inside the frame that comes to
+  const byte length = _direction == LCD_BAR_UP ? _h : _w;
+  const int inside = length > 2 ? length - 2 : 0;
+  long fill = 0;
+  if (_max > _min)
+    fill = ((long) value - _min) * inside / ((long) _max - _min);   // (in long: an int can overflow)
+  if (fill < 0)
+    fill = 0;
+  if (fill > inside)
+    fill = inside;
+
+  if (fill == _fill)
+    return;   // looks the same as before
+
+  // just what lies between the old and new ends
+  const byte from = fill < _fill ? fill : _fill;
+  const byte to = fill < _fill ? _fill : fill;
+  if (_direction == LCD_BAR_UP)
+    invalidate (1, _w - 2, (_h - 1 - to) >> 3, (_h - 2 - from) >> 3);   // rows _h - 1 - to .. _h - 2 - from
+  else
+    invalidate (from + 1, to, 0, 0xFF);   // columns from + 1 .. to
+
+  _fill = fill;
+}  // end of LCD_bar::setValue
+
+byte LCD_bar::column (const KS0108_display & lcd,
+                      const byte x,
+                      const byte page)
+{
+  // sides of the frame
+  if (x == 0 || x == _w - 1)
+    return rowBits (page, 0, _h - 1);
+
+  // filled up to _fill rows from the bottom
+  if (_direction == LCD_BAR_UP)
+    return rowBits (page, 0, 0) | rowBits (page, _h - 1 - _fill, _h - 1);
+
+  // filled part of the bar
+  if (x <= _fill)
+    return rowBits (page, 0, _h - 1);
+
+  // top and bottom of the frame
+  return rowBits (page, 0, 0) | rowBits (page, _h - 1, _h - 1);
+}  // end of LCD_bar::column
+
+
+// ---------------------------------------------------------------------------
+//  LCD_sparkline
+// ---------------------------------------------------------------------------
+
+void LCD_sparkline::add (const int value)
+{
+  // which row that is, 0 at the top
+  long row = _h - 1;
+  if (_max > _min)
+    row -= ((long) value - _min) * (_h - 1) / ((long) _max - _min);
+  if (row < 0)
+    row = 0;
+  if (row > _h - 1)
+    row = _h - 1;
+
+  _samples [_head] = row;
+  if (++_head >= _w)
+    _head = 0;
+  if (_count < _w)
+    _count++;
+
+  invalidate ();   // everything moves left
+}  // end of LCD_sparkline::add
+
+byte LCD_sparkline::column (const KS0108_display & lcd,
+                            const byte x,
+                            const byte page)
+{
+  // the newest value is in the right-most column
+  const byte age = _w - 1 - x;
+  if (age >= _count)
+    return 0;
+
+  const byte i = (_head + _w - 1 - age) % _w;
+  const byte row = _samples [i];
+
+  // join it to the value before, if there is one
+  byte before = row;
+  if (age + 1 < _count)
+    before = _samples [(i + _w - 1) % _w];
+
+  return row < before ? rowBits (page, row, before) : rowBits (page, before, row);
+}  // end of LCD_sparkline::column
+
+
+// ---------------------------------------------------------------------------
+//  LCD_icon
+// ---------------------------------------------------------------------------
+
+byte LCD_icon::column (const KS0108_display & lcd,
+                       const byte x,
+                       const byte page)
+{
+  if (!_visible || _bitmap == NULL)
+    return 0;
+
+  return pgm_read_byte (_bitmap + page * _w + x) & rowBits (page, 0, _h - 1);
+}  // end of LCD_icon::column
+
+
+// ---------------------------------------------------------------------------
+//  LCD_screen
+// ---------------------------------------------------------------------------
+
+void LCD_screen::add (LCD_widget & widget)
+{
+  widget._next = NULL;
+  widget.invalidate ();
+
+  // on the end of the list, so it is drawn over the ones before
+  if (_first == NULL)
+    _first = &widget;
+  else
+    {
+    LCD_widget * w = _first;
+    while (w->_next)
+      w = w->_next;
+    w->_next = &widget;
+    }
+}  // end of LCD_screen::add
+
+void LCD_screen::invalidate ()
+{
+  for (LCD_widget * w = _first; w; w = w->_next)
+    w->invalidate ();
+}  // end of LCD_screen::invalidate
+
+// the byte at column x, line page, from the top-most widget there
+byte LCD_screen::columnAt (const byte x,
+                           const byte page)
+{
+  byte bits = 0;
+  for (LCD_widget * w = _first; w; w = w->_next)
+    if (w->onPage (page) && x >= w->_x && x <= w->right ())
+      bits = w->column (_lcd, x - w->_x, page - w->_page);
+  return bits;
+}  // end of LCD_screen::columnAt
+
+// redraw the widgets that have changed: on each line, each stretch of changed widgets
+// (overlapping or touching) is sent as one run after a single gotoxy
+// widgets that only changed in part (eg. a bar moving) only have that part sent
+// with ASYNC_FLUSH this only updates the cache - call flush() or flushAsync() afterwards
+unsigned int LCD_screen::update ()
+{
+  unsigned int sent = 0;
+  const int lastX = _lcd.width () - 1;
+  const byte lines = _lcd.height () >> 3;
+  LCD_widget * w;
+
+  // widgets draw every pixel they own, whatever the drawing mode is
+  const byte mode = _lcd.getDrawMode ();
+  _lcd.setDrawMode (LCD_MODE_COPY);
+
+  for (byte page = 0; page < lines; page++)
+    {
+    int x = 0;    // this line is done up to here
+    while (true)
+      {
+      // the left-most changed widget that isn't done yet
+      int start = lastX + 1;
+      int end = -1;
+      for (w = _first; w; w = w->_next)
+        if (w->damagedOn (page) && w->damageRight () >= x)
+          {
+          const int from = w->damageLeft () > x ? w->damageLeft () : x;
+          if (from < start)
+            {
+            start = from;
+            end = w->damageRight ();
+            }
+          }
+      if (start > lastX)
+        break;    // nothing more on this line
+
+      // take in any others that overlap or touch it
+      boolean grew;
+      do
+        {
+        grew = false;
+        for (w = _first; w; w = w->_next)
+          if (w->damagedOn (page) && w->damageLeft () <= end + 1 && w->damageRight () > end)
+            {
+            end = w->damageRight ();
+            grew = true;
+            }
+        } while (grew);
+      if (end > lastX)
+        end = lastX;
+
+      _lcd.gotoxy (start, page << 3);
+      for (int c = start; c <= end; c++)
+        _lcd.writeData (columnAt (c, page), false);
+      sent += end - start + 1;
+      x = end + 1;
+      }  // end of while something to send
+    }  // end of for each line
+
+  for (w = _first; w; w = w->_next)
+    w->_dirty = false;
+
+  _lcd.setDrawMode (mode);
+  return sent;
+}  // end of LCD_screen::update
@@ -0,0 +1,256 @@
+/*
+ KS0108_widgets.h
+
+ Retained-mode widgets for the I2C_graphical_LCD_display library.
+
+ Instead of redrawing labels, readouts and bar graphs with gotoxy/string/fillRect on every
+ update, declare them once (as globals - nothing is allocated), add them to an LCD_screen,
+ and change their values as often as you like. LCD_screen::update() then redraws only the
+ widgets whose picture actually changed, so when nothing has changed nothing is sent.
+
+ Widgets supplied:
+
+   LCD_label      - a line of text (the string is not copied - call setText() again after changing it)
+   LCD_value      - a number (whole or fixed-point) in a field of a given number of characters
+   LCD_bar        - a bar graph or progress bar with a frame, filling across or up
+   LCD_sparkline  - a small line graph of the last few values, scrolling left
+   LCD_icon       - a bitmap in PROGMEM (as for blit), which can be shown, hidden or swapped
+
+ Widgets work in whole LCD lines of 8 pixels: y is rounded down to a multiple of 8, and the
+ widget owns every pixel of the lines it covers, drawing blank where it has nothing to show.
+ Widgets added later are drawn on top of earlier ones where they overlap.
+
+ Changed widgets on the same line that overlap or touch are sent as one run of bytes, after a
+ single gotoxy, so the LCD's address counter does the rest.
+
+ To make another kind of widget, derive from LCD_widget and implement column(), calling
+ invalidate() whenever what it shows changes.
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#ifndef KS0108_widgets_H
+#define KS0108_widgets_H
+
+#include "I2C_graphical_LCD_display.h"
+
+class LCD_widget
+{
+  friend class LCD_screen;
+
+public:
+
+  LCD_widget (const byte x, const byte y, const byte w, const byte h) :
+              _x (x), _page (y >> 3), _w (w), _h (h), _dirty (false), _next (NULL) { invalidate (); }
+
+  // the byte (8 pixels down, bit 0 at the top) for column x, line page - both counted from
+  // the widget's top-left corner - drawn in the current font of lcd if it needs text
+  virtual byte column (const KS0108_display & lcd, const byte x, const byte page) = 0;
+
+  void invalidate () { invalidate (0, 0xFF, 0, 0xFF); }    // redraw it all at the next update
+  boolean isDirty () const { return _dirty; }
+
+  // bounding box on the screen
+  byte left () const   { return _x; }
+  byte top () const    { return _page << 3; }
+  byte width () const  { return _w; }
+  byte height () const { return _h; }
+
+protected:
+
+  byte rowBits (const byte page, int from, int to) const;   // bits of rows from..to (inclusive) in line page
+  // redraw only columns x1..x2 of lines page1..page2 (counted from the widget's top-left corner)
+  void invalidate (const byte x1, const byte x2, const byte page1, const byte page2);
+
+  byte _x;        // left column
+  byte _page;     // top line (y / 8)
+  byte _w;        // width in pixels
+  byte _h;        // height in pixels, from the top of line _page
+
+private:
+
+  byte pages () const { return (_h + 7) >> 3; }
+  boolean onPage (const byte page) const { return page >= _page && page < _page + pages (); }
+  int right () const { return _x + _w - 1; }
+  boolean damagedOn (const byte page) const
+    { return _dirty && onPage (page) && page >= _page + _dirtyPage1 && page <= _page + _dirtyPage2; }
+  int damageLeft () const { return _x + _dirtyX1; }
+  int damageRight () const { return _x + _dirtyX2 < right () ? _x + _dirtyX2 : right (); }
+
+  boolean _dirty;         // needs redrawing
+  byte _dirtyX1, _dirtyX2;        // which columns (from the left of the widget)
+  byte _dirtyPage1, _dirtyPage2;  // and which lines (from the top of the widget)
+  LCD_widget * _next;     // next widget on the same screen
+
+};  // end of class LCD_widget
+
+
+// a line of text, in the display's current font
+
+class LCD_label : public LCD_widget
+{
+public:
+
+  // w is in pixels - text that doesn't fit is cut off
+  LCD_label (const byte x, const byte y, const byte w, const char * text = "", const boolean inv = false) :
+             LCD_widget (x, y, w, 8), _text (text), _inv (inv), _hash (hash (text)) {}
+
+  void setText (const char * text);       // only redrawn if the text is different
+  void setInv (const boolean inv) { if (inv != _inv) { _inv = inv; invalidate (); } }
+  const char * getText () const { return _text; }
+
+  virtual byte column (const KS0108_display & lcd, const byte x, const byte page);
+
+protected:
+
+  static unsigned int hash (const char * s);
+
+  const char * _text;
+  boolean _inv;         // white on black
+  unsigned int _hash;   // of the text as last set, to spot changes made in place
+
+};  // end of class LCD_label
+
+
+// a number in a field of the given number of characters (all stars if it doesn't fit)
+
+#define LCD_ALIGN_RIGHT 0
+#define LCD_ALIGN_LEFT  1
+
+class LCD_value : public LCD_label
+{
+public:
+
+  // charWidth is glyphWidth () of the font it will be drawn in (6 for the standard font)
+  // (digits is cut down to what fits in _buf, and in 255 columns)
+  LCD_value (const byte x, const byte y, const byte digits, const byte charWidth = 6, const boolean inv = false) :
+             LCD_label (x, y, fits (digits, charWidth) * charWidth, "", inv), _digits (fits (digits, charWidth)),
+             _charWidth (charWidth), _decimals (0), _align (LCD_ALIGN_RIGHT), _value (0)
+             { _text = _buf; format (); }
+
+  // only the letters that change are redrawn, so 1299 to 1300 sends three letters, 1300 to 1301 one
+  void setValue (const long value);
+  long getValue () const { return _value; }
+
+  // fixed point: the value is shown with this many digits after the decimal point (eg. 1234 as 12.34)
+  void setDecimals (const byte decimals) { _decimals = decimals > 9 ? 9 : decimals; format (); invalidate (); }
+  void setAlign (const byte align) { _align = align; format (); invalidate (); }   // LCD_ALIGN_RIGHT or LCD_ALIGN_LEFT
+
+private:
+
+  void format ();
+  static byte fits (const byte digits, const byte charWidth)   // how many of them we can show
+    {
+    const byte most = charWidth > 255 / 13 ? 255 / charWidth : 13;
+    return digits > most ? most : digits;
+    }
+
+  char _buf [14];   // room for -2147483648 and a decimal point
+  byte _digits;     // letters in the field
+  byte _charWidth;  // columns for each
+  byte _decimals;   // digits after the decimal point
+  byte _align;      // LCD_ALIGN_RIGHT or LCD_ALIGN_LEFT
+  long _value;
+
+};  // end of class LCD_value
+
+
+// a bar graph or progress bar: a frame, filled in proportion to the value
+
+#define LCD_BAR_RIGHT   0     // fills from the left
+#define LCD_BAR_UP      1     // fills from the bottom
+
+class LCD_bar : public LCD_widget
+{
+public:
+
+  LCD_bar (const byte x, const byte y, const byte w, const byte h, const int minimum = 0, const int maximum = 100,
+           const byte direction = LCD_BAR_RIGHT) :
+           LCD_widget (x, y, w, h), _min (minimum), _max (maximum), _fill (0), _direction (direction) {}
+
+  // only the part between the old and new ends of the bar is redrawn, so a meter going
+  // up or down a little sends a few columns across, or a line or two up
+  void setValue (const int value);
+
+  virtual byte column (const KS0108_display & lcd, const byte x, const byte page);
+
+private:
+
+  int _min, _max;
+  byte _fill;       // filled columns (or rows) inside the frame
+  byte _direction;  // LCD_BAR_RIGHT or LCD_BAR_UP
+
+};  // end of class LCD_bar
+
+
+// a line graph of the last w values, the newest on the right
+
+class LCD_sparkline : public LCD_widget
+{
+public:
+
+  // samples is w bytes to keep the history in (eg. a global array)
+  LCD_sparkline (const byte x, const byte y, const byte w, const byte h, byte * samples,
+                 const int minimum = 0, const int maximum = 100) :
+                 LCD_widget (x, y, w, h), _samples (samples), _min (minimum), _max (maximum), _head (0), _count (0) {}
+
+  void add (const int value);     // shift the graph left and add a value on the right
+  void reset () { _count = 0; invalidate (); }
+
+  virtual byte column (const KS0108_display & lcd, const byte x, const byte page);
+
+private:
+
+  byte * _samples;  // row of each value (0 = top), oldest first from _head
+  int _min, _max;
+  byte _head;       // where the next value goes
+  byte _count;      // values so far (up to _w)
+
+};  // end of class LCD_sparkline
+
+
+// a bitmap in PROGMEM, in the order blit uses: w bytes for each line of 8 pixels down
+
+class LCD_icon : public LCD_widget
+{
+public:
+
+  LCD_icon (const byte x, const byte y, const byte w, const byte h, const byte * bitmap = NULL) :
+            LCD_widget (x, y, w, h), _bitmap (bitmap), _visible (true) {}
+
+  void setBitmap (const byte * bitmap) { if (bitmap != _bitmap) { _bitmap = bitmap; invalidate (); } }
+  void setVisible (const boolean visible) { if (visible != _visible) { _visible = visible; invalidate (); } }
+
+  virtual byte column (const KS0108_display & lcd, const byte x, const byte page);
+
+private:
+
+  const byte * _bitmap;
+  boolean _visible;
+
+};  // end of class LCD_icon
+
+
+// the widgets on one display
+
+class LCD_screen
+{
+public:
+
+  LCD_screen (KS0108_display & lcd) : _lcd (lcd), _first (NULL) {}
+
+  void add (LCD_widget & widget);   // add to the top (drawn over earlier widgets where they overlap)
+  void invalidate ();               // redraw everything at the next update (eg. after clear)
+  unsigned int update ();           // redraw what has changed, returns the number of bytes sent
+
+private:
+
+  byte columnAt (const byte x, const byte page);   // what the top-most widget shows there
+
+  KS0108_display & _lcd;
+  LCD_widget * _first;
+
+};  // end of class LCD_screen
+
+#endif  // KS0108_widgets_H
@@ -0,0 +1,58 @@
+
+// Demo of display lists (KS0108_displaylist.h): a menu screen kept in PROGMEM, and a
+// status screen recorded into RAM once at startup. Switching between them sends each
+// byte of the screen once, however many frames, lines and labels they are made of.
+
+#include <I2C_graphical_LCD_display.h>
+#include <KS0108_displaylist.h>
+
+I2C_graphical_LCD_display lcd(6,7);
+
+// a face, 8 x 8, in the order blit uses
+const byte face [] PROGMEM = { 0x1C, 0x22, 0x49, 0xA1, 0xA1, 0x49, 0x22, 0x1C };
+
+const byte menuList [] PROGMEM = {
+  LCD_LIST_CLEAR (0, 0, 127, 63, 0),
+  LCD_LIST_FRAME (0, 0, 127, 63, 1, 1),
+  LCD_LIST_TEXT (4, 8, true), 'S', 'e', 't', 't', 'i', 'n', 'g', 's', 0,
+  LCD_LIST_LINE (1, 17, 126, 17, 1),
+  LCD_LIST_TEXT (8, 24, false), 'B', 'r', 'i', 'g', 'h', 't', 'n', 'e', 's', 's', 0,
+  LCD_LIST_TEXT (8, 32, false), 'C', 'o', 'n', 't', 'r', 'a', 's', 't', 0,
+  LCD_LIST_TEXT (8, 40, false), 'B', 'a', 'c', 'k', 0,
+  LCD_LIST_END };
+
+LCD_displayList menu (menuList);
+
+byte statusBuffer [100];
+LCD_displayList status (statusBuffer, sizeof statusBuffer);
+
+void setup () 
+{
+  Serial.begin (115200);
+  lcd.begin ();  
+
+  status.clear ();
+  status.frameRect (0, 0, 127, 63, 1, 2);
+  status.line (2, 9, 125, 9, 1);
+  status.string (40, 0, "Status", true);
+  status.string (8, 24, "All systems go");
+  status.blit (110, 48, 8, 8, face);
+
+  // print the status screen as a list for PROGMEM, ready to paste in
+  status.dump (Serial);
+}  // end of setup
+
+void loop () 
+{
+  menu.draw (lcd);
+#ifdef ASYNC_FLUSH
+  lcd.flush ();
+#endif
+  delay (2000);
+
+  status.draw (lcd);
+#ifdef ASYNC_FLUSH
+  lcd.flush ();
+#endif
+  delay (2000);
+}  // end of loop
@@ -0,0 +1,50 @@
+
+// Demo of the retained-mode widgets (KS0108_widgets.h): a title, a reading, a bar graph,
+// a sparkline of recent readings, and an icon that flashes.
+// After the first update only what has changed is sent to the LCD.
+
+#include <I2C_graphical_LCD_display.h>
+#include <KS0108_widgets.h>
+
+I2C_graphical_LCD_display lcd(6,7);
+
+// a face, 8 x 8, in the order blit uses
+const byte face [] PROGMEM = { 0x1C, 0x22, 0x49, 0xA1, 0xA1, 0x49, 0x22, 0x1C };
+
+byte history [100];   // one byte per column of the sparkline
+
+LCD_label     title     (0, 0, 90, "Analog 0");
+LCD_value     reading   (90, 0, 4);                  // 4 characters
+LCD_bar       level     (0, 16, 128, 8, 0, 1023);
+LCD_sparkline graph     (0, 32, 100, 32, history, 0, 1023);
+LCD_icon      alarm     (110, 40, 8, 8, face);
+
+LCD_screen screen (lcd);
+
+void setup () 
+{
+  lcd.begin ();  
+
+  screen.add (title);
+  screen.add (reading);
+  screen.add (level);
+  screen.add (graph);
+  screen.add (alarm);
+}  // end of setup
+
+void loop () 
+{
+  const int value = analogRead (0);
+
+  reading.setValue (value);
+  level.setValue (value);
+  graph.add (value);
+  alarm.setVisible (value > 900 && (millis () / 500) % 2);
+
+  screen.update ();   // only sends what changed
+#ifdef ASYNC_FLUSH
+  lcd.flush ();
+#endif
+
+  delay (100);
+}  // end of loop
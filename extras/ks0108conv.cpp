@@ -0,0 +1,302 @@
+/*
+ ks0108conv.cpp
+
+ Converts a grayscale picture into a header file for the I2C_graphical_LCD_display library.
+
+ This runs on the PC, not the Arduino. To build it (Linux, or anything with a C++ compiler):
+
+   g++ -O2 -o ks0108conv ks0108conv.cpp
+
+ The picture must be a PGM file (P2 or P5). Most image tools can save one, for example:
+
+   convert logo.png -colorspace gray logo.pgm
+
+ Usage:
+
+   ks0108conv [options] picture.pgm > picture.h
+
+ Options:
+
+   -n name    name of the array (default: picture)
+   -d method  how to turn gray into black and white:
+                fs     Floyd-Steinberg error diffusion (default - best for photos)
+                bayer  8x8 ordered dither (the same pattern as drawGrayImage)
+                none   plain threshold (best for line art and text)
+   -t level   threshold for -d none, 0 to 255 (default 128)
+   -i         invert (white pixels drawn black)
+   -z         run-length encode the result - draw it with blitRLE instead of blit
+   -g         don't dither: write the gray bytes themselves, row by row, for drawGrayImage
+
+ Output for blit is in the order the LCD (and the library's cache) uses: 8 pixels down in
+ each byte (bit 0 at the top), a byte for each column across, then the next 8 pixels down.
+ A picture as wide as the screen can be sent with blit (or blitRLE) straight after
+ gotoxy (0, y), with y a multiple of 8. The sizes are written as <name>_WIDTH, <name>_HEIGHT
+ and <name>_SIZE (bytes once unpacked).
+
+ Run-length encoding (-z): each block starts with a count byte. 0x80 + n means the next byte
+ is repeated n + 1 times; anything else, n, is followed by n + 1 bytes to copy as they are.
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+
+static int width, height;
+static std::vector <float> gray;    // 0 = black, 255 = white, row by row
+
+// 8x8 ordered dither matrix - the same as drawGrayImage uses
+static const unsigned char bayer8 [8] [8] = {
+  {  0, 32,  8, 40,  2, 34, 10, 42 },
+  { 48, 16, 56, 24, 50, 18, 58, 26 },
+  { 12, 44,  4, 36, 14, 46,  6, 38 },
+  { 60, 28, 52, 20, 62, 30, 54, 22 },
+  {  3, 35, 11, 43,  1, 33,  9, 41 },
+  { 51, 19, 59, 27, 49, 17, 57, 25 },
+  { 15, 47,  7, 39, 13, 45,  5, 37 },
+  { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+static void fail (const char * message, const char * detail = "")
+{
+  fprintf (stderr, "ks0108conv: %s%s\n", message, detail);
+  exit (1);
+}  // end of fail
+
+// next number in a PGM header, skipping white space and comments
+static int pgmNumber (FILE * f)
+{
+  int c = fgetc (f);
+  while (c != EOF && (isspace (c) || c == '#'))
+    {
+    if (c == '#')
+      while (c != EOF && c != '\n')
+        c = fgetc (f);
+    c = fgetc (f);
+    }
+
+  if (c == EOF || !isdigit (c))
+    fail ("bad PGM header");
+
+  int n = 0;
+  while (c != EOF && isdigit (c))
+    {
+    n = n * 10 + (c - '0');
+    c = fgetc (f);
+    }
+  return n;   // (the one white space character after it has been eaten)
+}  // end of pgmNumber
+
+// read a P2 (text) or P5 (binary) PGM file into gray
+static void readPGM (const char * name)
+{
+  FILE * f = fopen (name, "rb");
+  if (!f)
+    fail ("can't open ", name);
+
+  if (fgetc (f) != 'P')
+    fail ("not a PGM file: ", name);
+  const int type = fgetc (f);
+  if (type != '2' && type != '5')
+    fail ("not a grayscale PGM file (P2 or P5): ", name);
+
+  width = pgmNumber (f);
+  height = pgmNumber (f);
+  const int maxval = pgmNumber (f);
+  if (width < 1 || height < 1 || width > 255 || height > 255)
+    fail ("picture must be 1 to 255 pixels each way");
+  if (maxval < 1 || maxval > 65535)
+    fail ("bad maximum gray value");
+
+  gray.resize (width * height);
+  for (int i = 0; i < width * height; i++)
+    {
+    int v;
+    if (type == '2')
+      v = pgmNumber (f);
+    else if (maxval < 256)
+      v = fgetc (f);
+    else
+      {
+      v = fgetc (f) << 8;
+      v |= fgetc (f);
+      }
+    if (v < 0)
+      fail ("picture data cut short");
+    gray [i] = v * 255.0f / maxval;
+    }
+
+  fclose (f);
+}  // end of readPGM
+
+// turn gray into black (true) and white, row by row
+static std::vector <bool> dither (const std::string & method, const int threshold)
+{
+  std::vector <bool> black (width * height);
+
+  if (method == "fs")
+    {
+    // Floyd-Steinberg: push each pixel's error on to the ones not done yet
+    std::vector <float> g (gray);
+    for (int y = 0; y < height; y++)
+      for (int x = 0; x < width; x++)
+        {
+        const float old = g [y * width + x];
+        const bool b = old < 128;
+        const float err = old - (b ? 0 : 255);
+        black [y * width + x] = b;
+        if (x + 1 < width)
+          g [y * width + x + 1] += err * 7 / 16;
+        if (y + 1 < height)
+          {
+          if (x > 0)
+            g [(y + 1) * width + x - 1] += err * 3 / 16;
+          g [(y + 1) * width + x] += err * 5 / 16;
+          if (x + 1 < width)
+            g [(y + 1) * width + x + 1] += err * 1 / 16;
+          }
+        }
+    }
+  else if (method == "bayer")
+    {
+    for (int y = 0; y < height; y++)
+      for (int x = 0; x < width; x++)
+        black [y * width + x] = gray [y * width + x] < bayer8 [y & 7] [x & 7] * 4 + 2;
+    }
+  else if (method == "none")
+    {
+    for (int i = 0; i < width * height; i++)
+      black [i] = gray [i] < threshold;
+    }
+  else
+    fail ("unknown dither method: ", method.c_str ());
+
+  return black;
+}  // end of dither
+
+// pack into LCD order: a byte is 8 pixels down, bit 0 at the top
+static std::vector <unsigned char> pack (const std::vector <bool> & black)
+{
+  std::vector <unsigned char> out;
+
+  for (int top = 0; top < height; top += 8)
+    for (int x = 0; x < width; x++)
+      {
+      unsigned char b = 0;
+      for (int i = 0; i < 8 && top + i < height; i++)
+        if (black [(top + i) * width + x])
+          b |= 1 << i;
+      out.push_back (b);
+      }
+
+  return out;
+}  // end of pack
+
+// run-length encode, as blitRLE expects
+static std::vector <unsigned char> compress (const std::vector <unsigned char> & in)
+{
+  std::vector <unsigned char> out;
+  size_t i = 0;
+
+  while (i < in.size ())
+    {
+    // how many of the same byte start here?
+    size_t run = 1;
+    while (i + run < in.size () && run < 128 && in [i + run] == in [i])
+      run++;
+
+    if (run >= 3)
+      {
+      out.push_back (0x80 | (run - 1));
+      out.push_back (in [i]);
+      i += run;
+      continue;
+      }
+
+    // copy bytes as they are, up to the next run of 3 or more
+    size_t n = 0;
+    while (i + n < in.size () && n < 128)
+      {
+      if (i + n + 2 < in.size () && in [i + n] == in [i + n + 1] && in [i + n] == in [i + n + 2])
+        break;
+      n++;
+      }
+    out.push_back (n - 1);
+    out.insert (out.end (), in.begin () + i, in.begin () + i + n);
+    i += n;
+    }
+
+  return out;
+}  // end of compress
+
+int main (int argc, char * argv [])
+{
+  std::string name = "picture";
+  std::string method = "fs";
+  int threshold = 128;
+  bool invert = false, rle = false, grayOut = false;
+  const char * file = NULL;
+
+  for (int i = 1; i < argc; i++)
+    {
+    const std::string arg = argv [i];
+    if (arg == "-n" && i + 1 < argc)
+      name = argv [++i];
+    else if (arg == "-d" && i + 1 < argc)
+      method = argv [++i];
+    else if (arg == "-t" && i + 1 < argc)
+      threshold = atoi (argv [++i]);
+    else if (arg == "-i")
+      invert = true;
+    else if (arg == "-z")
+      rle = true;
+    else if (arg == "-g")
+      grayOut = true;
+    else if (arg [0] != '-' && !file)
+      file = argv [i];
+    else
+      fail ("usage: ks0108conv [-n name] [-d fs|bayer|none] [-t level] [-i] [-z] [-g] picture.pgm");
+    }
+
+  if (!file)
+    fail ("no picture given");
+
+  readPGM (file);
+
+  if (invert)
+    for (size_t i = 0; i < gray.size (); i++)
+      gray [i] = 255 - gray [i];
+
+  std::vector <unsigned char> data;
+  if (grayOut)
+    for (size_t i = 0; i < gray.size (); i++)
+      data.push_back ((unsigned char) (gray [i] + 0.5f));
+  else
+    data = pack (dither (method, threshold));
+
+  const size_t size = data.size ();
+  if (rle && !grayOut)
+    data = compress (data);
+
+  printf ("// %s: %d x %d pixels, from %s by ks0108conv\n", name.c_str (), width, height, file);
+  if (grayOut)
+    printf ("// draw with drawGrayImage (x, y, %s_WIDTH, %s_HEIGHT, %s)\n", name.c_str (), name.c_str (), name.c_str ());
+  else
+    printf ("// draw with %s (%s, %s_SIZE)%s\n", rle ? "blitRLE" : "blit", name.c_str (), name.c_str (),
+            rle ? "" : " - or blitRLE if made with -z");
+  printf ("\n#define %s_WIDTH  %d\n", name.c_str (), width);
+  printf ("#define %s_HEIGHT %d\n", name.c_str (), height);
+  printf ("#define %s_SIZE   %u\n\n", name.c_str (), (unsigned) size);
+  printf ("const byte %s [%u] PROGMEM = {", name.c_str (), (unsigned) data.size ());
+
+  for (size_t i = 0; i < data.size (); i++)
+    printf ("%s0x%02X%s", (i % 16) ? " " : "\n  ", data [i], (i + 1 < data.size ()) ? "," : "");
+  printf ("\n};\n");
+
+  return 0;
+}  // end of main
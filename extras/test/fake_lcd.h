@@ -0,0 +1,129 @@
+/*
+ fake_lcd.h
+
+ A pretend KS0108 panel for the host tests: it keeps the display RAM of each chip, with its own
+ page and column address (which moves one column right after each data byte, as on the real
+ chip), and counts what was sent. It can be read back, like the MCP23x17 boards, unless told
+ not to (like the 2-wire board).
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#ifndef fake_lcd_H
+#define fake_lcd_H
+
+#include <cstdio>
+#include <cstring>
+#include "I2C_graphical_LCD_display.h"
+
+class Fake_LCD : public KS0108_transport
+{
+public:
+
+  byte ram [4] [8] [64];    // chip, page, column
+  long dataBytes;           // data bytes written
+  long commands;            // commands written
+  long reads;               // data bytes read back
+
+  Fake_LCD (const boolean readable = true) : dataBytes (0), commands (0), reads (0), _readable (readable)
+    {
+    memset (ram, 0, sizeof ram);
+    memset (_page, 0, sizeof _page);
+    memset (_column, 0, sizeof _column);
+    }
+
+  virtual void begin (const LCD_timing & timing) { }
+
+  virtual void writeCommand (const byte chipSelect, const byte data)
+    {
+    commands++;
+    for (byte chip = 0; chip < 4; chip++)
+      if (chipSelect & chipBit (chip))
+        {
+        if ((data & 0xF8) == LCD_SET_PAGE)
+          _page [chip] = data & 7;
+        else if ((data & 0xC0) == LCD_SET_ADD)
+          _column [chip] = data & 63;
+        }
+    }
+
+  virtual void writeData (const byte chipSelect, const byte data)
+    {
+    const byte chip = which (chipSelect);
+    dataBytes++;
+    ram [chip] [_page [chip]] [_column [chip]] = data;
+    _column [chip] = (_column [chip] + 1) & 63;
+    }
+
+  virtual boolean canRead () { return _readable; }
+
+  virtual byte readData (const byte chipSelect)
+    {
+    const byte chip = which (chipSelect);
+    reads++;
+    const byte data = ram [chip] [_page [chip]] [_column [chip]];
+    _column [chip] = (_column [chip] + 1) & 63;
+    return data;
+    }
+
+  // the byte (8 pixels down) at physical column x, line page of the whole panel
+  byte at (const byte x, const byte page) const
+    {
+    return ram [(page >> 3) * LCD_CHIPS_ACROSS + (x >> 6)] [page & 7] [x & 63];
+    }
+
+  // the pixel at physical x, y
+  boolean pixel (const byte x, const byte y) const
+    {
+    return (at (x, y >> 3) >> (y & 7)) & 1;
+    }
+
+private:
+
+  static byte chipBit (const byte chip)
+    {
+    static const byte bits [4] = { LCD_CS1, LCD_CS2, LCD_CS3, LCD_CS4 };
+    return bits [chip];
+    }
+
+  static byte which (const byte chipSelect)
+    {
+    for (byte chip = 0; chip < 4; chip++)
+      if (chipSelect == chipBit (chip))
+        return chip;
+    fprintf (stderr, "fake_lcd: data with chip select %02X\n", chipSelect);
+    return 0;
+    }
+
+  boolean _readable;
+  byte _page [4];
+  byte _column [4];
+
+};  // end of class Fake_LCD
+
+// with ASYNC_FLUSH drawing only goes into the cache - send it, so the fake LCD can be looked at
+inline void settle (KS0108_display & lcd)
+{
+#ifdef ASYNC_FLUSH
+  lcd.flush ();
+#endif
+}  // end of settle
+
+// count a failure, printing the first few
+static int failures;
+
+inline void fail (const char * what, const int a = 0, const int b = 0, const int c = 0)
+{
+  if (++failures <= 10)
+    printf ("  FAILED: %s (%d, %d, %d)\n", what, a, b, c);
+}  // end of fail
+
+// what each test ends with: a summary line, and the exit status for run_tests.sh
+inline int finish (const char * name)
+{
+  printf ("%s: %s (%d failures)\n", name, failures ? "FAILED" : "ok", failures);
+  return failures ? 1 : 0;
+}  // end of finish
+
+#endif  // fake_lcd_H
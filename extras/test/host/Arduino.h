@@ -0,0 +1,69 @@
+/*
+ Arduino.h - just enough of the Arduino core to build the library on a PC, for the host tests.
+ Nothing here touches hardware: pins do nothing, and time moves on 3 microseconds each time
+ micros() is asked, so loops that wait on it always finish.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define HIGH      1
+#define LOW       0
+#define INPUT     0
+#define OUTPUT    1
+#define LSBFIRST  0
+#define MSBFIRST  1
+#define DEC       10
+#define HEX       16
+
+#define bit(b) (1UL << (b))
+
+inline unsigned long micros () { static unsigned long now; return now += 3; }
+inline unsigned long millis () { return micros () / 1000; }
+inline void delay (unsigned long) { }
+inline void delayMicroseconds (unsigned int) { }
+inline void pinMode (uint8_t, uint8_t) { }
+inline void digitalWrite (uint8_t, uint8_t) { }
+inline int digitalRead (uint8_t) { return LOW; }
+inline void noInterrupts () { }
+inline void interrupts () { }
+inline void yield () { }
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast <const __FlashStringHelper *> (s))
+
+class Print
+{
+public:
+  virtual ~Print () { }
+  virtual size_t write (uint8_t c) = 0;
+
+  size_t print (const char * s) { size_t n = 0; while (*s) n += write (*s++); return n; }
+  size_t print (const __FlashStringHelper * s) { return print (reinterpret_cast <const char *> (s)); }
+  size_t print (char c) { return write (c); }
+  size_t print (unsigned long v, int base = DEC)
+    {
+    char s [24];
+    snprintf (s, sizeof s, base == HEX ? "%lX" : "%lu", v);
+    return print (s);
+    }
+  size_t print (long v, int base = DEC) { return v < 0 && base == DEC ? print ('-') + print ((unsigned long) -v) : print ((unsigned long) v, base); }
+  size_t print (unsigned int v, int base = DEC) { return print ((unsigned long) v, base); }
+  size_t print (int v, int base = DEC) { return print ((long) v, base); }
+  size_t print (unsigned char v, int base = DEC) { return print ((unsigned long) v, base); }
+  size_t println () { return write ('\n'); }
+  template <class T> size_t println (T v) { return print (v) + println (); }
+  template <class T> size_t println (T v, int base) { return print (v, base) + println (); }
+};
+
+#endif  // Arduino_h
@@ -0,0 +1,35 @@
+/*
+ SPI.h - a do-nothing SPIClass for the host tests (the tests talk to a fake LCD instead)
+ */
+
+#ifndef SPI_h
+#define SPI_h
+
+#include "Arduino.h"
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings
+{
+public:
+  SPISettings () { }
+  SPISettings (uint32_t, uint8_t, uint8_t) { }
+};
+
+class SPIClass
+{
+public:
+  void begin () { }
+  void beginTransaction (SPISettings) { }
+  void endTransaction () { }
+  uint8_t transfer (uint8_t) { return 0; }
+  uint16_t transfer16 (uint16_t) { return 0; }
+  void transfer (void *, size_t) { }
+};
+
+extern SPIClass SPI;
+
+#endif  // SPI_h
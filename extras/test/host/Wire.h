@@ -0,0 +1,26 @@
+/*
+ Wire.h - a do-nothing TwoWire for the host tests (the tests talk to a fake LCD instead)
+ */
+
+#ifndef Wire_h
+#define Wire_h
+
+#include "Arduino.h"
+
+class TwoWire
+{
+public:
+  void begin () { }
+  void begin (uint8_t) { }
+  void setClock (uint32_t) { }
+  void beginTransmission (uint8_t) { }
+  size_t write (uint8_t) { return 1; }
+  uint8_t endTransmission () { return 0; }
+  uint8_t requestFrom (uint8_t, uint8_t) { return 1; }
+  int available () { return 1; }
+  int read () { return 0; }
+};
+
+extern TwoWire Wire;
+
+#endif  // Wire_h
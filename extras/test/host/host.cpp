@@ -0,0 +1,9 @@
+/*
+ host.cpp - the objects the stand-in Arduino headers declare
+ */
+
+#include "Wire.h"
+#include "SPI.h"
+
+TwoWire Wire;
+SPIClass SPI;
@@ -0,0 +1,87 @@
+#!/bin/sh
+#
+# run_tests.sh
+#
+# Host tests for the I2C_graphical_LCD_display library. These run on the PC, not the Arduino:
+# each test draws through the library onto a pretend panel (fake_lcd.h) and checks the result
+# against a model, in each of the configurations (library defines) listed below.
+#
+# To run them (Linux, or anything with a C++ compiler and a shell):
+#
+#   sh extras/test/run_tests.sh
+#
+# CXX picks the compiler (default g++). Exits with 1 if anything failed.
+#
+# SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+here=$(cd "$(dirname "$0")" && pwd)
+top=$(cd "$here/../.." && pwd)
+CXX=${CXX:-g++}
+out=$(mktemp -d)
+trap 'rm -rf "$out"' EXIT
+
+library="$top/I2C_graphical_LCD_display.cpp $top/KS0108_transport.cpp $top/KS0108_displaylist.cpp $here/host/host.cpp"
+failed=0
+
+# run test $1 with the defines in $2
+run ()
+{
+  printf '%-20s %-45s ' "$1" "${2:-(defaults)}"
+  if ! $CXX -std=gnu++11 -O1 -Wall -Wno-unused-parameter -DARDUINO=100 $2 \
+         -I"$here/host" -I"$top" -I"$here" -o "$out/$1" "$here/$1.cpp" $library 2> "$out/errors"
+  then
+    echo "did not build"
+    cat "$out/errors"
+    failed=1
+  elif ! "$out/$1" > "$out/output"
+  then
+    tail -n 11 "$out/output"
+    failed=1
+  else
+    tail -n 1 "$out/output"
+  fi
+}
+
+for config in "" "-DMCP23017" "-DASYNC_FLUSH" "-DLCD_WIDTH=192" "-DLCD_HEIGHT=128"
+do
+  run test_fill "$config"
+done
+
+for config in "" "-DMCP23017" "-DASYNC_FLUSH" "-DLCD_WIDTH=192" "-DLCD_HEIGHT=128" "-DLCD_ROTATION"
+do
+  run test_copy "$config"
+done
+
+for config in "" "-DMCP23017" "-DASYNC_FLUSH" "-DLCD_WIDTH=192" "-DLCD_HEIGHT=128" "-DLCD_ROTATION" "-DLCD_SCROLL_MAX=4"
+do
+  run test_scroll "$config"
+done
+
+for config in "" "-DMCP23017" "-DASYNC_FLUSH" "-DLCD_WIDTH=192" "-DLCD_HEIGHT=128" "-DLCD_ROTATION"
+do
+  run test_displaylist "$config"
+done
+
+for config in "" "-DMCP23017" "-DASYNC_FLUSH" "-DLCD_HEIGHT=128" "-DLCD_ROTATION"
+do
+  run test_image "$config"
+done
+
+for config in "-DASYNC_FLUSH" "-DASYNC_FLUSH -DLCD_VERIFY" "-DASYNC_FLUSH -DLCD_VERIFY -DMCP23017" \
+              "-DASYNC_FLUSH -DLCD_VERIFY -DLCD_WIDTH=192" "-DASYNC_FLUSH -DLCD_VERIFY -DLCD_HEIGHT=128"
+do
+  run test_flush "$config"
+done
+
+for config in "-DLCD_GRAYSCALE" "-DLCD_GRAYSCALE -DMCP23017" "-DLCD_GRAYSCALE -DASYNC_FLUSH" \
+              "-DLCD_GRAYSCALE -DASYNC_FLUSH -DLCD_WIDTH=192"
+do
+  run test_gray "$config"
+done
+
+if [ $failed -ne 0 ]
+then
+  echo "SOME TESTS FAILED"
+  exit 1
+fi
+echo "all passed"
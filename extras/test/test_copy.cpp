@@ -0,0 +1,108 @@
+/*
+ test_copy.cpp
+
+ copyRect() against a pixel model: 300 random copies, a third of them overlapping their source
+ by a few pixels each way (which is where the order bytes are read and written in matters),
+ some running off the screen. With LCD_ROTATION the display is turned 90 degrees first.
+
+ Build and run with run_tests.sh.
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#include "fake_lcd.h"
+
+static byte model [256] [256];   // what each pixel should be, as drawn (x, y)
+
+// the pixel the LCD shows at x, y as drawn
+static boolean shown (Fake_LCD & lcd, const int x, const int y)
+{
+#ifdef LCD_ROTATION
+  return lcd.pixel (LCD_WIDTH - 1 - y, x);   // (setOrientation (1): 90 degrees clockwise)
+#else
+  return lcd.pixel (x, y);
+#endif
+}  // end of shown
+
+int main ()
+{
+  srand (44);
+
+  Fake_LCD fake;
+  KS0108_display lcd (fake);
+  lcd.begin ();
+#ifdef LCD_ROTATION
+  lcd.setOrientation (1);
+#endif
+  const int W = lcd.width ();
+  const int H = lcd.height ();
+
+  // a random picture
+  for (int y = 0; y < H; y++)
+    for (int x = 0; x < W; x++)
+      {
+      model [x] [y] = rand () % 3 == 0;
+      lcd.setPixel (x, y, model [x] [y]);
+      }
+
+  for (int t = 0; t < 300; t++)
+    {
+    const int sx = rand () % (W + 5), sy = rand () % (H + 5);
+    const int w = rand () % W, h = rand () % H;
+    int dx, dy;
+    if (t % 3 == 0)
+      {
+      // on top of itself, moved a little
+      dx = sx + rand () % 7 - 3;
+      dy = sy + rand () % 11 - 5;
+      if (dx < 0)
+        dx = 0;
+      if (dy < 0)
+        dy = 0;
+      }
+    else
+      {
+      dx = rand () % W;
+      dy = rand () % H;
+      }
+
+    lcd.copyRect (sx, sy, w, h, dx, dy);
+
+    // both rectangles are clipped to the screen
+    if (sx < W && sy < H && dx < W && dy < H)
+      {
+      int cw = w, ch = h;
+      if (cw > W - sx) cw = W - sx;
+      if (cw > W - dx) cw = W - dx;
+      if (ch > H - sy) ch = H - sy;
+      if (ch > H - dy) ch = H - dy;
+      static byte before [256] [256];
+      memcpy (before, model, sizeof model);
+      for (int x = 0; x < cw; x++)
+        for (int y = 0; y < ch; y++)
+          model [dx + x] [dy + y] = before [sx + x] [sy + y];
+      }
+
+    settle (lcd);
+    for (int y = 0; y < H; y++)
+      for (int x = 0; x < W; x++)
+        if (shown (fake, x, y) != model [x] [y])
+          {
+          fail ("copyRect", t, x, y);
+          y = H;
+          break;
+          }
+    }
+
+#if defined(WRITETHROUGH_CACHE) && !defined(ASYNC_FLUSH) && !defined(LCD_ROTATION) && LCD_WIDTH == 128 && LCD_HEIGHT == 64
+  // a 100 x 48 strip chart moved one column left: the source comes from the cache, so only
+  // the destination bytes are sent, a batch (with its gotoxy) at a time
+  const long data = fake.dataBytes, commands = fake.commands;
+  lcd.copyRect (1, 8, 100, 48, 0, 8);
+  if (fake.dataBytes - data != 600 || fake.commands - commands != 62)
+    fail ("strip chart data bytes / commands", fake.dataBytes - data, fake.commands - commands);
+#endif
+
+  return finish ("test_copy");
+}  // end of main
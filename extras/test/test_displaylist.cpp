@@ -0,0 +1,214 @@
+/*
+ test_displaylist.cpp
+
+ LCD_displayList against the display calls it records: 3000 random lists (clear, fillRect,
+ frameRect, line, setPixel, string and blit, some running off the screen) are drawn on one
+ pretend LCD, and the same calls made directly on another, over the same background - the two
+ screens must match byte for byte. Then a list in PROGMEM, and what the menu screen costs.
+
+ Build and run with run_tests.sh.
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#include <cstdlib>
+#include "fake_lcd.h"
+#include "KS0108_displaylist.h"
+
+// what the menu costs is checked on the default board and screen, where nothing is held back
+#if defined(WRITETHROUGH_CACHE) && !defined(ASYNC_FLUSH) && !defined(LCD_ROTATION) && LCD_WIDTH == 128 && LCD_HEIGHT == 64
+#define CHECK_COSTS
+#endif
+
+static const byte pic [] PROGMEM = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+                                     13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24 };
+
+static int random (const int n)
+{
+  return rand () % n;
+}  // end of random
+
+// the first byte that differs between the two screens
+static void compare (Fake_LCD & want, Fake_LCD & got, const char * what, const int t)
+{
+  for (int page = 0; page < LCD_HEIGHT / 8; page++)
+    for (int x = 0; x < LCD_WIDTH; x++)
+      if (want.at (x, page) != got.at (x, page))
+        {
+        fail (what, t, x, page);
+        return;
+        }
+}  // end of compare
+
+int main ()
+{
+  srand (49);
+
+  for (int t = 0; t < 3000; t++)
+    {
+    Fake_LCD wantLCD, gotLCD;
+    KS0108_display direct (wantLCD), listed (gotLCD);
+    direct.begin ();
+    listed.begin ();
+#ifdef LCD_ROTATION
+    direct.setOrientation (t % 4, t & 4, t & 8);
+    listed.setOrientation (t % 4, t & 4, t & 8);
+#endif
+    const int W = direct.width ();
+    const int H = direct.height ();
+
+    // something to draw over
+    for (int i = 0; i < 5; i++)
+      {
+      const int x1 = random (W), y1 = random (H), x2 = random (W), y2 = random (H);
+      direct.line (x1, y1, x2, y2);
+      listed.line (x1, y1, x2, y2);
+      }
+    direct.setPattern (t % 10);
+    listed.setPattern (t % 10);
+    settle (direct);
+    settle (listed);
+
+    byte buffer [600];
+    LCD_displayList list (buffer, sizeof buffer);
+    const int entries = 1 + random (12);
+    for (int i = 0; i < entries; i++)
+      {
+      int x1 = random (W + 20), y1 = random (H + 10), x2 = random (W + 20), y2 = random (H + 10);
+      const byte val = random (2);
+      if (random (3) == 0)
+        {
+        // all on the screen
+        x1 = random (W);
+        x2 = random (W);
+        y1 = random (H);
+        y2 = random (H);
+        }
+      switch (random (7))
+        {
+        case 0:
+          {
+          const byte fill = random (3) ? (val ? 0xFF : 0) : random (256);
+          list.clear (x1, y1, x2, y2, fill);
+          direct.clear (x1, y1, x2, y2, fill);
+          break;
+          }
+        case 1:
+          list.fillRect (x1, y1, x2, y2, val);
+          direct.fillRect (x1, y1, x2, y2, val);
+          break;
+        case 2:
+          {
+          const byte width = 1 + random (3);
+          list.frameRect (x1, y1, x2, y2, val, width);
+          direct.frameRect (x1, y1, x2, y2, val, width);
+          break;
+          }
+        case 3:
+          list.line (x1, y1, x2, y2, val);
+          direct.line (x1, y1, x2, y2, val);
+          break;
+        case 4:
+          list.setPixel (x1, y1, val);
+          direct.setPixel (x1, y1, val);
+          break;
+        case 5:
+          {
+          const char * s = val ? "Hi there" : "Ab~";
+          const boolean inv = random (2);
+          x1 = random (W - 48);
+          y1 = random (H) & ~7;
+          list.string (x1, y1, s, inv);
+          direct.gotoxy (x1, y1);
+          direct.string (s, inv);
+          break;
+          }
+        case 6:
+          {
+          // a picture with its last line cut short: the rows below it are left alone
+          const int h = 1 + random (24);
+          int w = 24 / ((h + 7) / 8);
+          if (w > 8)
+            w = 8;
+          x1 = random (W - 8);
+          y1 &= ~7;
+          list.blit (x1, y1, w, h, pic);
+          for (int line = 0; line < (h + 7) / 8; line++)
+            for (int x = 0; x < w; x++)
+              for (int row = 0; row < 8 && line * 8 + row < h; row++)
+                direct.setPixel (x1 + x, y1 + line * 8 + row, (pgm_read_byte (pic + line * w + x) >> row) & 1);
+          break;
+          }
+        }  // end of switch
+      }
+
+#if !defined(ASYNC_FLUSH) && !defined(LCD_ROTATION)
+    // nothing is held back, so what draw says it sent is what the LCD got
+    const long before = gotLCD.dataBytes;
+    const long sent = list.draw (listed);
+    if (gotLCD.dataBytes - before != sent)
+      fail ("bytes sent", t, gotLCD.dataBytes - before, sent);
+#else
+    list.draw (listed);
+#endif
+    settle (direct);
+    settle (listed);
+    compare (wantLCD, gotLCD, "draw", t);
+    }
+
+  // a list in PROGMEM
+  static const byte menu [] PROGMEM = {
+    LCD_LIST_CLEAR (0, 0, 127, 63, 0),
+    LCD_LIST_FRAME (0, 0, 127, 63, 1, 1),
+    LCD_LIST_TEXT (4, 8, true), 'S', 'e', 't', 't', 'i', 'n', 'g', 's', 0,
+    LCD_LIST_LINE (1, 17, 126, 17, 1),
+    LCD_LIST_TEXT (4, 24, false), 'B', 'r', 'i', 'g', 'h', 't', 'n', 'e', 's', 's', 0,
+    LCD_LIST_TEXT (4, 32, false), 'C', 'o', 'n', 't', 'r', 'a', 's', 't', 0,
+    LCD_LIST_TEXT (4, 40, false), 'B', 'a', 'c', 'k', 0,
+    LCD_LIST_BITMAP (100, 48, 3, 8), 0x3C, 0x42, 0x3C,
+    LCD_LIST_END };
+
+  Fake_LCD wantLCD, gotLCD;
+  KS0108_display direct (wantLCD), listed (gotLCD);
+  direct.begin ();
+  listed.begin ();
+#ifdef CHECK_COSTS
+  const long directData = wantLCD.dataBytes, directCommands = wantLCD.commands;
+#endif
+  direct.clear (0, 0, 127, 63, 0);
+  direct.frameRect (0, 0, 127, 63, 1, 1);
+  direct.gotoxy (4, 8);
+  direct.string ("Settings", true);
+  direct.line (1, 17, 126, 17, 1);
+  direct.gotoxy (4, 24);
+  direct.string ("Brightness");
+  direct.gotoxy (4, 32);
+  direct.string ("Contrast");
+  direct.gotoxy (4, 40);
+  direct.string ("Back");
+#ifdef CHECK_COSTS
+  // drawn call by call, bytes where the calls meet are sent again, each after a gotoxy
+  if (wantLCD.dataBytes - directData != 1710 || wantLCD.commands - directCommands != 1206)
+    fail ("menu call by call data bytes / commands", wantLCD.dataBytes - directData, wantLCD.commands - directCommands);
+#endif
+  direct.gotoxy (100, 48);
+  direct.writeData (0x3C);
+  direct.writeData (0x42);
+  direct.writeData (0x3C);
+
+#ifdef CHECK_COSTS
+  // as a list each byte of the screen is sent once, in runs
+  const long data = gotLCD.dataBytes, commands = gotLCD.commands;
+  LCD_displayList (menu).draw (listed);
+  if (gotLCD.dataBytes - data != 1024 || gotLCD.commands - commands != 48)
+    fail ("menu data bytes / commands", gotLCD.dataBytes - data, gotLCD.commands - commands);
+#else
+  LCD_displayList (menu).draw (listed);
+#endif
+  settle (direct);
+  settle (listed);
+  compare (wantLCD, gotLCD, "PROGMEM list", 0);
+
+  return finish ("test_displaylist");
+}  // end of main
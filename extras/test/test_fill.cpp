@@ -0,0 +1,155 @@
+/*
+ test_fill.cpp
+
+ fillRect() and fillCircle(), in every drawing mode and fill pattern, against a pixel model.
+ The circle model is the row-by-row one fillCircle used before it worked in columns, so the
+ same pixels must come out: radii 0 to 39, circles clipped by every edge, and random rectangles.
+
+ Build and run with run_tests.sh.
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#include "fake_lcd.h"
+
+static byte model [LCD_WIDTH] [LCD_HEIGHT];   // what each pixel should be
+static byte pattern [8];                      // the user pattern in use
+
+// draw one pixel of a fill into the model, as changeBits does
+static void shade (const int x, const int y, const byte val, const byte mode)
+{
+  if (x < 0 || y < 0 || x >= LCD_WIDTH || y >= LCD_HEIGHT)
+    return;
+  const boolean in = (pattern [x & 7] >> (y & 7)) & 1;
+  byte & p = model [x] [y];
+  switch (mode)
+    {
+    case LCD_MODE_SET:   if (val && in) p = 1;  break;
+    case LCD_MODE_CLEAR: if (val && in) p = 0;  break;
+    case LCD_MODE_XOR:   if (val && in) p ^= 1; break;
+    default:             p = val && in;         break;
+    }
+}  // end of shade
+
+// rows y0 + dy and y0 - dy, from x0 - dx to x0 + dx
+static void modelRows (const int x0, const int y0, const int dx, const int dy, const byte val, const byte mode)
+{
+  for (int x = x0 - dx; x <= x0 + dx; x++)
+    {
+    shade (x, y0 + dy, val, mode);
+    if (dy)
+      shade (x, y0 - dy, val, mode);
+    }
+}  // end of modelRows
+
+// a filled circle, drawn a row at a time as fillCircle used to (each row once, so XOR works)
+static void modelCircle (const int x0, const int y0, const int r, const byte val, const byte mode)
+{
+  int x = r;
+  int y = 0;
+  int err = 0;
+  while (x >= y)
+    {
+    modelRows (x0, y0, x, y, val, mode);
+
+    ++y;
+    err += 1 + 2 * y;
+    if (2 * (err - x) + 1 > 0)
+      {
+      // row x is finished - its widest span was the last y
+      if (x >= y)
+        modelRows (x0, y0, y - 1, x, val, mode);
+      --x;
+      err += 1 - 2 * x;
+      }
+    }
+}  // end of modelCircle
+
+static void compare (Fake_LCD & lcd, const char * what, const int a, const int b)
+{
+  for (int x = 0; x < LCD_WIDTH; x++)
+    for (int y = 0; y < LCD_HEIGHT; y++)
+      if (lcd.pixel (x, y) != model [x] [y])
+        {
+        fail (what, a, b, x * 1000 + y);
+        return;
+        }
+}  // end of compare
+
+int main ()
+{
+  srand (43);
+
+  Fake_LCD fake;
+  KS0108_display lcd (fake);
+  lcd.begin ();
+
+  // something to draw over
+  for (int page = 0; page < LCD_HEIGHT / 8; page++)
+    {
+    lcd.gotoxy (0, page * 8);
+    for (int x = 0; x < LCD_WIDTH; x++)
+      {
+      const byte b = rand ();
+      lcd.writeData (b);
+      for (int i = 0; i < 8; i++)
+        model [x] [page * 8 + i] = (b >> i) & 1;
+      }
+    }
+  settle (lcd);
+  compare (fake, "background", 0, 0);
+
+  for (byte mode = LCD_MODE_COPY; mode <= LCD_MODE_XOR; mode++)
+    {
+    lcd.setDrawMode (mode);
+
+    // circles, solid then in a random pattern
+    for (int r = 0; r < 40; r++)
+      {
+      if (r & 1)
+        for (int i = 0; i < 8; i++)
+          pattern [i] = rand ();
+      else
+        memset (pattern, 0xFF, sizeof pattern);
+      lcd.setUserPattern (pattern);
+
+      // in the middle, then against each edge in turn
+      const int x0 = (r % 5 == 1) ? rand () % (r + 1) : (r % 5 == 2) ? LCD_WIDTH - 1 - rand () % (r + 1) : rand () % LCD_WIDTH;
+      const int y0 = (r % 5 == 3) ? rand () % (r + 1) : (r % 5 == 4) ? LCD_HEIGHT - 1 - rand () % (r + 1) : rand () % LCD_HEIGHT;
+      const byte val = rand () % 4 != 0;
+      lcd.fillCircle (x0, y0, r, val);
+      modelCircle (x0, y0, r, val, mode);
+      settle (lcd);
+      compare (fake, "fillCircle", mode, r);
+      }
+
+    // rectangles, some running off the screen
+    for (int i = 0; i < 50; i++)
+      {
+      for (int j = 0; j < 8; j++)
+        pattern [j] = (i & 1) ? rand () : 0xFF;
+      lcd.setUserPattern (pattern);
+      const int x1 = rand () % (LCD_WIDTH + 8), y1 = rand () % (LCD_HEIGHT + 8);
+      const int x2 = x1 + rand () % 80, y2 = y1 + rand () % 70;
+      const byte val = rand () % 4 != 0;
+      lcd.fillRect (x1, y1, x2 > 255 ? 255 : x2, y2 > 255 ? 255 : y2, val);
+      for (int x = x1; x <= x2; x++)
+        for (int y = y1; y <= y2; y++)
+          shade (x, y, val, mode);
+      settle (lcd);
+      compare (fake, "fillRect", mode, i);
+      }
+    }
+
+  // each byte of a rectangle gets one read-modify-write: 40 columns x 7 lines
+  lcd.setDrawMode (LCD_MODE_COPY);
+  lcd.setPattern (LCD_PATTERN_SOLID);
+  const long before = fake.dataBytes;
+  lcd.fillRect (10, 5, 49, 54);
+  settle (lcd);
+  if (fake.dataBytes - before != 40 * 7)
+    fail ("fillRect 40 x 50 data bytes", fake.dataBytes - before, 40 * 7);
+
+  return finish ("test_fill");
+}  // end of main
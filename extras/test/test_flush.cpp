@@ -0,0 +1,184 @@
+/*
+ test_flush.cpp
+
+ flushSome(), flushFor() and pending() (ASYNC_FLUSH): each call keeps to its budget, pending()
+ goes down by exactly what was sent, small changes go out ahead of big ones, and flushFor sends
+ at least one lot. flushAsync() driven by flushTick() while drawing goes on: isBusy() until it
+ is done, and the callback called once. Then (with LCD_VERIFY) drawing, flushSome and
+ verifyTick mixed at random, on an LCD that can be read back and one that can't: verifyTick
+ must never find the screen wrong, and once everything is sent it must match a pixel model.
+
+ Build and run with run_tests.sh.
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#include <cstdlib>
+#include "fake_lcd.h"
+
+#ifndef ASYNC_FLUSH
+#error test_flush needs ASYNC_FLUSH
+#endif
+
+static byte model [LCD_WIDTH] [LCD_HEIGHT];   // what each pixel should be
+
+static void compare (Fake_LCD & lcd, const char * what, const int a)
+{
+  for (int x = 0; x < LCD_WIDTH; x++)
+    for (int y = 0; y < LCD_HEIGHT; y++)
+      if (lcd.pixel (x, y) != model [x] [y])
+        {
+        fail (what, a, x, y);
+        return;
+        }
+}  // end of compare
+
+// a random solid rectangle, up to w x h, drawn and put in the model
+static void rectangle (KS0108_display & lcd, const int w, const int h)
+{
+  const int x1 = rand () % LCD_WIDTH, y1 = rand () % LCD_HEIGHT;
+  int x2 = x1 + rand () % w, y2 = y1 + rand () % h;
+  if (x2 >= LCD_WIDTH)
+    x2 = LCD_WIDTH - 1;
+  if (y2 >= LCD_HEIGHT)
+    y2 = LCD_HEIGHT - 1;
+  const byte val = rand () % 2;
+  lcd.fillRect (x1, y1, x2, y2, val);
+  for (int x = x1; x <= x2; x++)
+    for (int y = y1; y <= y2; y++)
+      model [x] [y] = val;
+}  // end of rectangle
+
+// the flushAsync callback
+static int flushesDone;
+
+static void flushDone ()
+{
+  flushesDone++;
+}  // end of flushDone
+
+int main ()
+{
+  srand (50);
+
+  {
+  Fake_LCD fake;
+  KS0108_display lcd (fake);
+  lcd.begin ();
+  memset (model, 0, sizeof model);
+
+  // slices: never more than asked for, and pending () goes down by what was sent
+  for (int t = 0; t < 200; t++)
+    {
+    for (int i = rand () % 4; i >= 0; i--)
+      rectangle (lcd, 100, 40);
+    while (lcd.pending ())
+      {
+      const unsigned int budget = 1 + rand () % 70;
+      const unsigned int before = lcd.pending ();
+      const long data = fake.dataBytes;
+      const unsigned int left = lcd.flushSome (budget);
+      const long sent = fake.dataBytes - data;
+      if (sent > (long) budget || (sent < (long) budget && left) || left != lcd.pending () || before - left != sent)
+        fail ("flushSome budget / pending", budget, sent, before - left);
+      }
+    compare (fake, "flushSome", t);
+    }
+
+  // a digit drawn below a clear that is still going out goes first
+  lcd.clear (0, 48, LCD_WIDTH - 1, 55, 0);
+  lcd.flush ();
+  lcd.clear (0, 0, LCD_WIDTH - 1, 31, 0xFF);
+  lcd.flushSome (LCD_WIDTH);
+  lcd.fillRect (70, 50, 70, 53);
+  lcd.flushSome (1);
+  if (!fake.pixel (70, 51) || !lcd.pending ())
+    fail ("small change first", fake.pixel (70, 51), lcd.pending ());
+  lcd.flushSome (LCD_WIDTH * LCD_HEIGHT);
+  for (int x = 0; x < LCD_WIDTH; x++)
+    {
+    for (int y = 0; y < 32; y++)
+      model [x] [y] = 1;
+    for (int y = 48; y < 56; y++)
+      model [x] [y] = x == 70 && y >= 50 && y <= 53;
+    }
+  compare (fake, "after clear", 0);
+
+  // flushFor: at least one lot, even with no time at all; and all of it, given long enough
+  lcd.clear ();
+  long data = fake.dataBytes;
+  unsigned int left = lcd.flushFor (0);
+  if (fake.dataBytes - data != 8 || left != LCD_WIDTH * LCD_HEIGHT / 8 - 8)
+    fail ("flushFor (0)", fake.dataBytes - data, left);
+  data = fake.dataBytes;
+  left = lcd.flushFor (1000000);
+  if (left || fake.dataBytes - data != LCD_WIDTH * LCD_HEIGHT / 8 - 8)
+    fail ("flushFor (1 s)", fake.dataBytes - data, left);
+  memset (model, 0, sizeof model);
+  compare (fake, "flushFor", 0);
+
+  // flushAsync, with flushTick a few bytes at a time and drawing going on meanwhile: busy until
+  // the last tick, which calls done once - and what was drawn during the flush goes with it
+  for (int t = 0; t < 100; t++)
+    {
+    for (int i = rand () % 4; i >= 0; i--)
+      rectangle (lcd, 100, 40);
+    flushesDone = 0;
+    lcd.flushAsync (flushDone);
+    int ticks = 0;
+    for (;;)
+      {
+      if (!lcd.isBusy () || flushesDone)
+        {
+        fail ("flushAsync finished early", t, ticks, flushesDone);
+        break;
+        }
+      if (ticks < 50 && rand () % 8 == 0)
+        rectangle (lcd, 30, 10);
+      ticks++;
+      if (!lcd.flushTick (1 + rand () % 4))
+        break;
+      }
+    if (lcd.isBusy () || flushesDone != 1 || lcd.pending ())
+      fail ("flushAsync done", t, lcd.isBusy (), flushesDone);
+    if (lcd.flushTick (1) || flushesDone != 1)
+      fail ("flushTick after the flush", t, flushesDone);
+    compare (fake, "flushAsync", t);
+    }
+  }
+
+#ifdef LCD_VERIFY
+  // verifyTick between slices (it sets the LCD's address for its own line, on the same chip
+  // as the run flushSome is part way through)
+  for (int readable = 1; readable >= 0; readable--)
+    {
+    Fake_LCD fake (readable);
+    KS0108_display lcd (fake);
+    lcd.begin ();
+    memset (model, 0, sizeof model);
+
+    for (int t = 0; t < 3000; t++)
+      {
+      switch (rand () % 4)
+        {
+        case 0:
+          rectangle (lcd, 60, 20);
+          break;
+        case 1:
+          lcd.flushSome (10);
+          break;
+        default:
+          if (lcd.verifyTick ())
+            fail ("verifyTick found the screen wrong", readable, t);
+          break;
+        }
+      }
+
+    lcd.flushSome (LCD_WIDTH * LCD_HEIGHT);
+    compare (fake, readable ? "flushSome and verifyTick (read back)" : "flushSome and verifyTick", readable);
+    }
+#endif
+
+  return finish ("test_flush");
+}  // end of main
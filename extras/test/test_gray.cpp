@@ -0,0 +1,114 @@
+/*
+ test_gray.cpp
+
+ grayTick() (LCD_GRAYSCALE) mixed at random with drawing - including between a gotoxy and the
+ writeData calls after it - and (with ASYNC_FLUSH) with flushSome(), with a small budget so the
+ planes are sent a few bytes at a time. Each of them carries on from where the LCD's address was
+ left, so none may move it under the others: once grayscale is stopped, and everything sent, the
+ LCD must show the first plane of a model of the gray levels.
+
+ Build and run with run_tests.sh.
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#include <cstdlib>
+#include "fake_lcd.h"
+
+#ifndef LCD_GRAYSCALE
+#error test_gray needs LCD_GRAYSCALE
+#endif
+
+static byte model [LCD_WIDTH] [LCD_HEIGHT];   // the gray level of each pixel (0 to 3)
+
+// a random rectangle, up to w x h: gray, or drawn as usual (black or white)
+static void rectangle (KS0108_display & lcd, const int w, const int h)
+{
+  const int x1 = rand () % LCD_WIDTH, y1 = rand () % LCD_HEIGHT;
+  int x2 = x1 + rand () % w, y2 = y1 + rand () % h;
+  if (x2 >= LCD_WIDTH)
+    x2 = LCD_WIDTH - 1;
+  if (y2 >= LCD_HEIGHT)
+    y2 = LCD_HEIGHT - 1;
+  byte level = rand () % 4;
+  if (rand () % 2)
+    lcd.fillGrayRect (x1, y1, x2, y2, level);
+  else
+    {
+    lcd.fillRect (x1, y1, x2, y2, level & 1);
+    level = (level & 1) ? 3 : 0;
+    }
+  for (int x = x1; x <= x2; x++)
+    for (int y = y1; y <= y2; y++)
+      model [x] [y] = level;
+}  // end of rectangle
+
+int main ()
+{
+  srand (33);
+
+  for (int budget = 1; budget <= 16; budget *= 4)
+    {
+    Fake_LCD fake;
+    KS0108_display lcd (fake);
+    lcd.begin ();
+    memset (model, 0, sizeof model);
+    lcd.setGrayscale (true, 300, budget);
+
+    for (int t = 0; t < 5000; t++)
+      {
+      switch (rand () % 5)
+        {
+        case 0:
+          rectangle (lcd, 40, 20);
+          break;
+        case 1:
+          {
+          // a few bytes from a gotoxy, with a grayTick in between
+          const int x = rand () % (LCD_WIDTH - 4), page = rand () % (LCD_HEIGHT / 8);
+          const int count = 1 + rand () % 4;
+          lcd.gotoxy (x, page * 8);
+          lcd.grayTick ();
+          for (int i = 0; i < count; i++)
+            {
+            const byte b = rand ();
+            lcd.writeData (b);
+            for (int row = 0; row < 8; row++)
+              model [x + i] [page * 8 + row] = ((b >> row) & 1) ? 3 : 0;
+            }
+          break;
+          }
+        case 2:
+#ifdef ASYNC_FLUSH
+          lcd.flushSome (10);
+#endif
+          break;
+        default:
+          lcd.grayTick ();
+          break;
+        }
+      }
+
+    // stop, and let the first plane go back
+    lcd.setGrayscale (false);
+    for (int i = 0; lcd.grayTick (); i++)
+      if (i > 100000)
+        {
+        fail ("grayTick did not stop", budget);
+        break;
+        }
+    settle (lcd);
+
+    for (int x = 0; x < LCD_WIDTH; x++)
+      for (int y = 0; y < LCD_HEIGHT; y++)
+        if (fake.pixel (x, y) != (model [x] [y] >> 1))
+          {
+          fail ("grayTick", budget, x, y);
+          x = LCD_WIDTH;
+          break;
+          }
+    }
+
+  return finish ("test_gray");
+}  // end of main
@@ -0,0 +1,101 @@
+/*
+ test_image.cpp
+
+ drawGrayImage() in every drawing mode, inverted and not, at heights and places that start and
+ end part way down a line of 8 pixels: the picture's pixels must be combined with the screen as
+ the mode says, and every pixel above and below it left alone. What the dithered picture looks
+ like comes from drawing it once on a blank screen, in LCD_MODE_COPY.
+
+ Build and run with run_tests.sh.
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#include <cstdlib>
+#include "fake_lcd.h"
+
+static byte pic [40 * 30];   // the picture (on the host, PROGMEM is ordinary memory)
+
+// the pixel the LCD shows at x, y as drawn
+static boolean shown (Fake_LCD & lcd, const int x, const int y)
+{
+#ifdef LCD_ROTATION
+  return lcd.pixel (LCD_WIDTH - 1 - y, x);   // (setOrientation (1): 90 degrees clockwise)
+#else
+  return lcd.pixel (x, y);
+#endif
+}  // end of shown
+
+int main ()
+{
+  srand (34);
+
+  Fake_LCD fake, blankFake;
+  KS0108_display lcd (fake), blank (blankFake);
+  lcd.begin ();
+  blank.begin ();
+#ifdef LCD_ROTATION
+  lcd.setOrientation (1);
+  blank.setOrientation (1);
+#endif
+  const int W = lcd.width ();
+  const int H = lcd.height ();
+
+  static byte before [256] [256];
+
+  for (int t = 0; t < 400; t++)
+    {
+    const byte mode = t % 4;
+    const boolean inv = (t / 4) % 2;
+
+    // something to draw over
+    for (int y = 0; y < H; y++)
+      for (int x = 0; x < W; x++)
+        {
+        before [x] [y] = rand () % 2;
+        lcd.setPixel (x, y, before [x] [y]);
+        }
+
+    const int w = 1 + rand () % 40, h = 1 + rand () % 30;
+    const int x = rand () % (W - 10), y = rand () % (H - 4);
+    for (int i = 0; i < w * h; i++)
+      pic [i] = rand ();
+
+    blank.clear ();
+    blank.drawGrayImage (x, y, w, h, pic);
+    settle (blank);
+
+    lcd.setDrawMode (mode);
+    lcd.setInv (inv);
+    lcd.drawGrayImage (x, y, w, h, pic);
+    lcd.setDrawMode (LCD_MODE_COPY);
+    lcd.setInv (false);
+    settle (lcd);
+
+    for (int py = 0; py < H; py++)
+      for (int px = 0; px < W; px++)
+        {
+        byte want = before [px] [py];
+        if (px >= x && px < x + w && py >= y && py < y + h)
+          {
+          const byte dot = shown (blankFake, px, py) ^ inv;
+          switch (mode)
+            {
+            case LCD_MODE_SET:   want |= dot;  break;
+            case LCD_MODE_CLEAR: want &= !dot; break;
+            case LCD_MODE_XOR:   want ^= dot;  break;
+            default:             want = dot;   break;
+            }
+          }
+        if (shown (fake, px, py) != want)
+          {
+          fail ("drawGrayImage", t, px, py);
+          py = H;
+          break;
+          }
+        }
+    }
+
+  return finish ("test_image");
+}  // end of main
@@ -0,0 +1,106 @@
+/*
+ test_scroll.cpp
+
+ scrollRegion() against a model: 400 random scrolls, left and right, mostly by a few columns
+ but some by more than LCD_SCROLL_MAX or the whole width, with new columns or blank ones,
+ over regions running off the screen and starting part-way down a line.
+
+ Build and run with run_tests.sh.
+
+ SEE I2C_graphical_LCD_display.h FOR LICENSE
+
+ */
+
+#include <cstdlib>
+#include "fake_lcd.h"
+
+static byte model [256] [256];   // what each pixel should be, as drawn (x, y)
+
+// the pixel the LCD shows at x, y as drawn
+static boolean shown (Fake_LCD & lcd, const int x, const int y)
+{
+#ifdef LCD_ROTATION
+  return lcd.pixel (LCD_WIDTH - 1 - y, x);   // (setOrientation (1): 90 degrees clockwise)
+#else
+  return lcd.pixel (x, y);
+#endif
+}  // end of shown
+
+int main ()
+{
+  srand (45);
+
+  Fake_LCD fake;
+  KS0108_display lcd (fake);
+  lcd.begin ();
+#ifdef LCD_ROTATION
+  lcd.setOrientation (1);
+#endif
+  const int W = lcd.width ();
+  const int H = lcd.height ();
+
+  // a random picture
+  for (int y = 0; y < H; y++)
+    for (int x = 0; x < W; x++)
+      {
+      model [x] [y] = rand () % 3 == 0;
+      lcd.setPixel (x, y, model [x] [y]);
+      }
+
+  static byte columns [32 * 256];   // new columns: up to 32 lines of up to 256
+  static byte before [256] [256];
+
+  for (int t = 0; t < 400; t++)
+    {
+    const int x1 = rand () % W, y1 = rand () % H;
+    const int x2 = x1 + rand () % (W + 10 - x1), y2 = y1 + rand () % (H + 4 - y1);
+    const int dx = rand () % 5 == 0 ? rand () % (2 * W) - W : rand () % 9 - 4;
+    const boolean blank = rand () % 4 == 0;
+    for (unsigned int i = 0; i < sizeof columns; i++)
+      columns [i] = rand ();
+
+    lcd.scrollRegion (x1, y1, x2 > 255 ? 255 : x2, y2 > 255 ? 255 : y2, dx, blank ? NULL : columns);
+
+    // whole 8-pixel lines, clipped to the screen
+    const int right = x2 < W ? x2 : W - 1;
+    const int bottom = y2 < H ? y2 : H - 1;
+    const int n = dx < 0 ? -dx : dx;
+    memcpy (before, model, sizeof model);
+    for (int top = y1 & ~7, line = 0; top <= bottom; top += 8, line++)
+      for (int x = x1; x <= right; x++)
+        {
+        const int from = x - dx;
+        byte c = 0;
+        if (from >= x1 && from <= right)
+          for (int i = 0; i < 8; i++)
+            c |= before [from] [top + i] << i;
+        else if (!blank)
+          c = columns [line * n + (dx > 0 ? x - x1 : x - (right - n + 1))];
+        for (int i = 0; i < 8; i++)
+          model [x] [top + i] = (c >> i) & 1;
+        }
+
+    settle (lcd);
+    for (int y = 0; y < H; y++)
+      for (int x = 0; x < W; x++)
+        if (shown (fake, x, y) != model [x] [y])
+          {
+          fail ("scrollRegion", t, x, y);
+          y = H;
+          break;
+          }
+    }
+
+#if defined(WRITETHROUGH_CACHE) && !defined(ASYNC_FLUSH) && !defined(LCD_ROTATION) && LCD_WIDTH == 128 && LCD_HEIGHT == 64
+  // a 100 x 48 strip chart moved one column left: the old columns come from the cache, so it
+  // is a byte per column, and for each of the 6 lines a page and column address for each chip
+  // (4 commands), then a gotoxy at the end (2)
+  const byte sample [6] = { 1, 2, 4, 8, 16, 32 };
+  const long data = fake.dataBytes, commands = fake.commands;
+  lcd.scrollRegion (0, 8, 99, 55, -1, sample);
+  if (fake.dataBytes - data != 600 || fake.commands - commands != 26)
+    fail ("strip chart data bytes / commands", fake.dataBytes - data, fake.commands - commands);
+#endif
+
+  return finish ("test_scroll");
+}  // end of main